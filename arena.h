@@ -0,0 +1,93 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*
+ * A bump allocator for working storage that lives for one frame. Allocating moves a pointer through the current block,
+ * and a new block, twice the size of the last, is only added when that one is full. Nothing is freed on its own; `reset`
+ * gives everything back at once. If the frame needed more than one block, `reset` replaces them with a single block as
+ * large as all of them together, so from then on frames of the same size allocate nothing at all.
+ *
+ * Only trivially destructible types may be allocated, since no destructors are run.
+ */
+class FrameArena
+{
+	private:
+		struct Block
+		{
+			std::unique_ptr<unsigned char[]> data;
+			std::size_t size;
+		};
+		
+		std::vector<Block> m_blocks;
+		// Bytes used in the last block.
+		std::size_t m_used = 0;
+		
+		void addBlock(std::size_t size)
+		{
+			m_blocks.push_back({std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+			m_used = 0;
+		}
+		
+	public:
+		explicit FrameArena(std::size_t initialSize = 64*1024) {addBlock(initialSize);}
+		
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+		FrameArena(FrameArena&&) = default;
+		FrameArena& operator=(FrameArena&&) = default;
+		
+		void* allocate(std::size_t size, std::size_t alignment)
+		{
+			Block* block = &m_blocks.back();
+			std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block->data.get());
+			std::size_t offset = (base + m_used + alignment - 1) / alignment * alignment - base;
+			if (offset + size > block->size)
+			{
+				addBlock(std::max(2*block->size, size + alignment));
+				block = &m_blocks.back();
+				base = reinterpret_cast<std::uintptr_t>(block->data.get());
+				offset = (base + alignment - 1) / alignment * alignment - base;
+			}
+			m_used = offset + size;
+			return block->data.get() + offset;
+		}
+		
+		// Uninitialized storage for `count` objects of type `T`.
+		template <typename T>
+		T* allocate(std::size_t count)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+			return static_cast<T*>(allocate(count*sizeof(T), alignof(T)));
+		}
+		
+		void reset()
+		{
+			if (m_blocks.size() > 1)
+			{
+				std::size_t total = 0;
+				for (const Block& block: m_blocks)
+					total += block.size;
+				m_blocks.clear();
+				addBlock(total);
+			}
+			m_used = 0;
+		}
+		
+		// The bytes held by the arena, in use or not.
+		std::size_t getCapacity() const
+		{
+			std::size_t total = 0;
+			for (const Block& block: m_blocks)
+				total += block.size;
+			return total;
+		}
+};
+
+#endif
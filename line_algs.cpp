@@ -1,147 +1,141 @@
-#include <windows.h>
-#include <GL/glut.h>
-#include <cmath>
-
-using lineAlgorithm_t = void(*)(int, int, int, int);
+#include "raster.h"
+#include <cstring>
 
 constexpr int k_width = 300;
 constexpr int k_height = 300;
 constexpr int k_windowPosX = 100;
 constexpr int k_windowPosY = 100;
 
-/* 
- * For both the DDA and Bresenham's algorithm, the line function is from `x` to `y` if `deltaX` > `deltaY`, and from `y` to
- * `x` otherwise. The implementations below take advantage of the fact that neither algorithm requires substantial
- * modification if the line function is instead defined from `d` to `r`, where `d` is an element of its domain and `r` is an
- * element of its range, and where the domain and range depend on whether `deltaX` is smaller or larger than `deltaY`.
- */
- 
-double signum(double x, double y)
+void init()
 {
-	return static_cast<bool>(y) * std::copysign(x, y);
+	glClearColor(1.0, 1.0, 1.0, 0.0);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluOrtho2D(0, k_width, 0, k_height);
+	glClear(GL_COLOR_BUFFER_BIT);
 }
 
-void lineDDA(int x1, int y1, int x2, int y2)
+struct SceneGroup
 {
-	double deltaX = x2 - x1, deltaY = y2 - y1;
-	double x = x1, y = y1;
-	double stop, domainStep, rangeStep, m;
-	double *domainVar, *rangeVar;
-	if (std::abs(deltaX) > std::abs(deltaY))
-	{
-		m = deltaY / deltaX, stop = x2;
-		domainVar = &x, rangeVar = &y;
-		domainStep = signum(1.0, deltaX);
-		rangeStep = signum(m, deltaY);
-	}
-	else
-	{
-		m = deltaX / deltaY, stop = y2;
-		domainVar = &y, rangeVar = &x;
-		domainStep = signum(1.0, deltaY);
-		rangeStep = signum(m, deltaX);
-	}
-	while (std::abs(*domainVar - stop))
+	double color[3];
+	int first;
+	int count;
+};
+
+// Each segment is {x1, y1, x2, y2}.
+constexpr int k_sceneSegments[][4]
+{
+	// house 1
+	{5, 5, 5, 20}, {5, 20, 47, 20}, {47, 5, 47, 20}, {5, 5, 47, 5}, {5, 20, 26, 41}, {26, 41, 47, 20},
+	// house 2
+	{55, 5, 55, 20}, {55, 20, 97, 20}, {97, 5, 97, 20}, {55, 5, 97, 5}, {55, 20, 76, 100}, {76, 100, 97, 20},
+	// house 3
+	{105, 5, 105, 20}, {105, 20, 147, 20}, {147, 5, 147, 20}, {105, 5, 147, 5}, {105, 20, 126, 25}, {126, 25, 147, 20},
+	// star
+	{105, 100, 147, 100}, {126, 76, 126, 124}, {147, 124, 105, 76}, {105, 124, 147, 76},
+	{137, 76, 116, 124}, {137, 124, 116, 76}, {147, 88, 105, 112}, {147, 112, 105, 88}
+};
+
+constexpr SceneGroup k_sceneGroups[]
+{
+	{{0.0, 0.0, 0.0}, 0, 6},
+	{{0.6, 0.4, 0.3}, 6, 6},
+	{{0.6, 0.0, 0.3}, 12, 6},
+	{{1.0, 1.0, 0.0}, 18, 8}
+};
+
+template <typename Sink>
+void drawScene(Sink& sink, lineAlgorithm_t<Sink> alg)
+{
+	sink.begin();
+	for (const SceneGroup& group: k_sceneGroups)
 	{
-		glVertex2i(std::round(x), std::round(y));
-		*domainVar += domainStep, *rangeVar += rangeStep;
+		sink.setColor(packColor(group.color[0], group.color[1], group.color[2]));
+		for (int i = group.first; i < group.first + group.count; ++i)
+			alg(sink, k_sceneSegments[i][0], k_sceneSegments[i][1], k_sceneSegments[i][2], k_sceneSegments[i][3]);
 	}
+	sink.end();
 }
 
-void lineBresenham(int x1, int y1, int x2, int y2)
+// Draws the same scene as `drawScene` with Bresenham's algorithm, handing each group to `lineBresenhamBatch` at once.
+template <typename Sink>
+void drawSceneBatched(Sink& sink)
 {
-	int deltaX = std::abs(x2 - x1), deltaY = std::abs(y2 - y1);
-	int x = x1, y = y1;
-	int *domainVar, *rangeVar, *domainDelta, *rangeDelta;
-	int domainStep, rangeStep;
-	if (deltaX > deltaY)
-	{
-		domainVar = &x, rangeVar = &y;
-		domainDelta = &deltaX, rangeDelta = &deltaY;
-		domainStep = static_cast<int>(signum(1.0, x2 - x1));
-		rangeStep = static_cast<int>(signum(1.0, y2 - y1));
-	}
-	else
+	std::vector<int> x1, y1, x2, y2;
+	sink.begin();
+	for (const SceneGroup& group: k_sceneGroups)
 	{
-		domainVar = &y, rangeVar = &x;
-		domainDelta = &deltaY, rangeDelta = &deltaX;
-		domainStep = static_cast<int>(signum(1.0, y2 - y1));
-		rangeStep = static_cast<int>(signum(1.0, x2 - x1));
-	}
-	int p = 2*(*rangeDelta) - *domainDelta;
-	// `d_lower` and `d_upper` are special cases of `d_same` and `d_changed` for when slope is positive.
-	int same = 2*(*rangeDelta);
-	int changed = same - 2*(*domainDelta);
-	for (int i = 0; i < *domainDelta; ++i)
-	{
-		glVertex2i(x, y);
-		*domainVar += domainStep;
-		if (p < 0)
-			p += same;
-		else
+		sink.setColor(packColor(group.color[0], group.color[1], group.color[2]));
+		x1.clear(), y1.clear(), x2.clear(), y2.clear();
+		for (int i = group.first; i < group.first + group.count; ++i)
 		{
-			p += changed;
-			*rangeVar += rangeStep;
+			x1.push_back(k_sceneSegments[i][0]), y1.push_back(k_sceneSegments[i][1]);
+			x2.push_back(k_sceneSegments[i][2]), y2.push_back(k_sceneSegments[i][3]);
 		}
+		lineBresenhamBatch(sink, SegmentSpan{x1.data(), y1.data(), x2.data(), y2.data(), x1.size()});
 	}
+	sink.end();
 }
 
-void init()
+/*
+ * Renders the scene into a `Framebuffer` instead of a window and writes it to `path`, so that the line algorithms can run
+ * on machines without a GPU or display. A null `alg` selects `drawSceneBatched`.
+ */
+bool drawHeadless(const char* path, lineAlgorithm_t<Framebuffer> alg)
 {
-	glClearColor(1.0, 1.0, 1.0, 0.0);
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluOrtho2D(0, k_width, 0, k_height);
-	glClear(GL_COLOR_BUFFER_BIT);
+	Framebuffer framebuffer(k_width, k_height);
+	if (alg)
+		drawScene(framebuffer, alg);
+	else
+		drawSceneBatched(framebuffer);
+	return framebuffer.writePPM(path);
 }
 
-void drawScene(lineAlgorithm_t alg)
+// Display functions:
+
+void drawWithDDA()
 {
-	glBegin(GL_POINTS);
-	// house 1
-	glColor3f(0.0, 0.0, 0.0);
-	alg(5, 5, 5, 20);
-	alg(5, 20, 47, 20);
-	alg(47, 5, 47, 20);
-	alg(5, 5, 47, 5);
-	alg(5, 20, 26, 41);
-	alg(26, 41, 47, 20);
-	// house 2
-	glColor3f(0.6, 0.4, 0.3);
-	alg(55, 5, 55, 20);
-	alg(55, 20, 97, 20);
-	alg(97, 5, 97, 20);
-	alg(55, 5, 97, 5);
-	alg(55, 20, 76, 100);
-	alg(76, 100, 97, 20);
-	// house 3
-	glColor3f(0.6, 0.0, 0.3);
-	alg(105, 5, 105, 20);
-	alg(105, 20, 147, 20);
-	alg(147, 5, 147, 20);
-	alg(105, 5, 147, 5);
-	alg(105, 20, 126, 25);
-	alg(126, 25, 147, 20);
-	// star
-	glColor3f(1.0, 1.0, 0.0);
-	alg(105, 100, 147, 100);
-	alg(126, 76, 126, 124);
-	alg(147, 124, 105, 76);
-	alg(105, 124, 147, 76);
-	alg(137, 76, 116, 124);
-	alg(137, 124, 116, 76);
-	alg(147, 88, 105, 112);
-	alg(147, 112, 105, 88);
-	glEnd();
-	glFlush();
+	GLSink sink;
+	drawScene(sink, lineDDA);
 }
 
-// Display functions:
-void drawWithDDA() {drawScene(lineDDA);}
-void drawWithBresenham() {drawScene(lineBresenham);}
+void drawWithBresenham()
+{
+	GLSink sink;
+	drawScene(sink, lineBresenham);
+}
 
+void drawWithBatchedBresenham()
+{
+	GLSink sink;
+	drawSceneBatched(sink);
+}
+
+void drawWithWu()
+{
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLSink sink;
+	drawScene(sink, lineWu);
+	glDisable(GL_BLEND);
+}
+
+// Usage: line_algs [--headless <output.ppm> [dda|bresenham|runs|batch|wu]]
 int main(int argc, char** argv)
 {
+	if (argc >= 3 && !std::strcmp(argv[1], "--headless"))
+	{
+		lineAlgorithm_t<Framebuffer> alg = lineBresenham;
+		if (argc >= 4 && !std::strcmp(argv[3], "dda"))
+			alg = lineDDA;
+		else if (argc >= 4 && !std::strcmp(argv[3], "runs"))
+			alg = lineBresenhamRuns;
+		else if (argc >= 4 && !std::strcmp(argv[3], "batch"))
+			alg = nullptr;
+		else if (argc >= 4 && !std::strcmp(argv[3], "wu"))
+			alg = lineWu;
+		return drawHeadless(argv[2], alg) ? 0 : 1;
+	}
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
 	glutInitWindowPosition(k_windowPosX, k_windowPosY);
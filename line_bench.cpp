@@ -0,0 +1,346 @@
+#include "raster.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Benchmarks the line rasterizers in raster.h. Every algorithm draws the same set of segments into a `NullSink`, which
+ * measures the rasterizer on its own, and into a `Framebuffer`, which adds the cost of writing pixels to memory. The
+ * segments come from a number of distributions that differ in length and orientation. Results are written as JSON, one
+ * object per (distribution, sink, algorithm), so that runs can be stored and compared to catch regressions.
+ *
+ * Usage: line_bench [--size <canvas size>] [--segments <count>] [--min-time <seconds>] [--seed <seed>]
+ *                   [--distribution <name>]... [--output <file>]
+ */
+
+constexpr int k_defaultSize = 2048;
+constexpr int k_defaultSegments = 100000;
+constexpr double k_defaultMinTime = 0.25;
+constexpr unsigned int k_defaultSeed = 12345;
+
+enum class Orientation
+{
+	random,
+	axisAligned,
+	nearAxis,
+	diagonal
+};
+
+struct Distribution
+{
+	const char* name;
+	int minLength;
+	int maxLength;
+	Orientation orientation;
+};
+
+// A `maxLength` of zero means that the endpoints are placed anywhere on the canvas, independently of each other.
+constexpr Distribution k_distributions[]
+{
+	{"short-random", 1, 16, Orientation::random},
+	{"short-axis", 1, 16, Orientation::axisAligned},
+	{"short-diagonal", 1, 16, Orientation::diagonal},
+	{"long-random", 256, 1024, Orientation::random},
+	{"long-axis", 256, 1024, Orientation::axisAligned},
+	{"long-near-axis", 256, 1024, Orientation::nearAxis},
+	{"long-diagonal", 256, 1024, Orientation::diagonal},
+	{"uniform-endpoints", 0, 0, Orientation::random}
+};
+
+/*
+ * Discards pixels, but folds their coordinates into a checksum. Simply counting them would let the compiler replace a
+ * rasterizer's loop with its trip count once the sink has been inlined.
+ */
+class NullSink
+{
+	private:
+		unsigned int m_checksum = 0;
+		
+		// In unsigned arithmetic, since shifting a y of 32768 or more left by 16 would overflow an int.
+		static unsigned int mix(int x, int y)
+		{
+			return static_cast<std::uint32_t>(x) ^ static_cast<std::uint32_t>(y) << 16;
+		}
+		
+	public:
+		unsigned int getChecksum() const {return m_checksum;}
+		
+		void begin() {}
+		void end() {}
+		void setColor(unsigned int) {}
+		void setPixel(int x, int y) {m_checksum = m_checksum*31 + mix(x, y);}
+		
+		void setPixels(const int* xs, const int* ys, int count)
+		{
+			for (int i = 0; i < count; ++i)
+				setPixel(xs[i], ys[i]);
+		}
+		
+		void blendPixels(const int* xs, const int* ys, const unsigned char* coverages, int count)
+		{
+			for (int i = 0; i < count; ++i)
+				m_checksum = m_checksum*31 + mix(xs[i], ys[i]) + coverages[i];
+		}
+		
+		void setHSpan(int x, int y, int length) {m_checksum = m_checksum*31 + mix(x, y) + length;}
+		void setVSpan(int x, int y, int length) {m_checksum = m_checksum*37 + mix(x, y) + length;}
+};
+
+struct Segments
+{
+	std::vector<int> x1;
+	std::vector<int> y1;
+	std::vector<int> x2;
+	std::vector<int> y2;
+
+	SegmentSpan span() const {return SegmentSpan{x1.data(), y1.data(), x2.data(), y2.data(), x1.size()};}
+};
+
+Segments generateSegments(const Distribution& distribution, int size, int count, std::mt19937& engine)
+{
+	std::uniform_int_distribution<int> coord(0, size - 1), length(distribution.minLength, distribution.maxLength);
+	std::uniform_int_distribution<int> coin(0, 1), slant(-16, 16);
+	std::uniform_real_distribution<double> angle(0.0, 6.283185307179586);
+	Segments segments;
+	for (int i = 0; i < count; ++i)
+	{
+		int x1 = coord(engine), y1 = coord(engine), deltaX = 0, deltaY = 0;
+		if (!distribution.maxLength)
+			deltaX = coord(engine) - x1, deltaY = coord(engine) - y1;
+		else
+		{
+			int major = length(engine);
+			int sign = coin(engine) ? 1 : -1;
+			switch (distribution.orientation)
+			{
+				case Orientation::random:
+				{
+					double theta = angle(engine);
+					deltaX = static_cast<int>(std::lround(major*std::cos(theta)));
+					deltaY = static_cast<int>(std::lround(major*std::sin(theta)));
+					break;
+				}
+				case Orientation::axisAligned:
+					deltaX = sign*major, deltaY = 0;
+					break;
+				case Orientation::nearAxis:
+					deltaX = sign*major, deltaY = major*slant(engine)/256;
+					break;
+				case Orientation::diagonal:
+					deltaX = sign*major, deltaY = (coin(engine) ? 1 : -1)*major;
+					break;
+			}
+			if (coin(engine))
+				std::swap(deltaX, deltaY);
+		}
+		// Segments that would leave the canvas are turned around so that as many pixels as possible are written.
+		if (x1 + deltaX < 0 || x1 + deltaX >= size)
+			deltaX = -deltaX;
+		if (y1 + deltaY < 0 || y1 + deltaY >= size)
+			deltaY = -deltaY;
+		segments.x1.push_back(x1), segments.y1.push_back(y1);
+		segments.x2.push_back(x1 + deltaX), segments.y2.push_back(y1 + deltaY);
+	}
+	return segments;
+}
+
+template <typename Sink>
+struct Algorithm
+{
+	const char* name;
+	void (*draw)(Sink&, const SegmentSpan&);
+};
+
+template <typename Sink, lineAlgorithm_t<Sink> Alg>
+void drawEach(Sink& sink, const SegmentSpan& segments)
+{
+	for (std::size_t i = 0; i < segments.count; ++i)
+		Alg(sink, segments.x1[i], segments.y1[i], segments.x2[i], segments.y2[i]);
+}
+
+// New rasterizers are benchmarked by adding them here.
+template <typename Sink>
+std::vector<Algorithm<Sink>> getAlgorithms()
+{
+	return
+	{
+		{"lineDDA", drawEach<Sink, lineDDA<Sink>>},
+		{"lineDDAFixed<32>", drawEach<Sink, lineDDAFixed<32, Sink>>},
+		{"lineBresenham", drawEach<Sink, lineBresenham<Sink>>},
+		{"lineBresenhamRuns", drawEach<Sink, lineBresenhamRuns<Sink>>},
+		{"lineBresenhamBatch", lineBresenhamBatch<Sink>},
+		{"lineWu", drawEach<Sink, lineWu<Sink>>}
+	};
+}
+
+// The number of pixels that each algorithm, in the order of `getAlgorithms`, writes for `segments`.
+std::vector<std::size_t> countPixels(const SegmentSpan& segments)
+{
+	std::vector<std::size_t> counts;
+	for (const Algorithm<CountingSink>& algorithm: getAlgorithms<CountingSink>())
+	{
+		CountingSink counter;
+		algorithm.draw(counter, segments);
+		counts.push_back(counter.getCount());
+	}
+	return counts;
+}
+
+const Distribution* findDistribution(const char* name)
+{
+	for (const Distribution& distribution: k_distributions)
+	{
+		if (!std::strcmp(distribution.name, name))
+			return &distribution;
+	}
+	return nullptr;
+}
+
+struct Settings
+{
+	int size = k_defaultSize;
+	int segments = k_defaultSegments;
+	double minTime = k_defaultMinTime;
+	unsigned int seed = k_defaultSeed;
+	std::vector<std::string> distributions;
+	const char* output = nullptr;
+};
+
+class JsonWriter
+{
+	private:
+		std::FILE* m_file;
+		bool m_firstResult = true;
+		
+	public:
+		JsonWriter(std::FILE* file, const Settings& settings): m_file(file)
+		{
+#ifdef __AVX2__
+			const char* simd = "avx2";
+#else
+			const char* simd = "none";
+#endif
+			std::fprintf(m_file, "{\n  \"canvas\": %d,\n  \"segments\": %d,\n  \"seed\": %u,\n  \"simd\": \"%s\",\n",
+				settings.size, settings.segments, settings.seed, simd);
+			std::fprintf(m_file, "  \"results\": [");
+		}
+		
+		~JsonWriter() {std::fprintf(m_file, "\n  ]\n}\n");}
+		
+		void addResult(const char* distribution, const char* sink, const char* algorithm, std::size_t segments,
+			std::size_t pixels, double seconds, int passes)
+		{
+			double perPass = seconds / passes;
+			std::fprintf(m_file, "%s\n    {\"distribution\": \"%s\", \"sink\": \"%s\", \"algorithm\": \"%s\", ",
+				m_firstResult ? "" : ",", distribution, sink, algorithm);
+			std::fprintf(m_file, "\"passes\": %d, \"pixels\": %zu, \"ns_per_segment\": %.3f, \"mpixels_per_second\": %.3f}",
+				passes, pixels, perPass*1e9 / segments, pixels / perPass / 1e6);
+			m_firstResult = false;
+		}
+};
+
+/*
+ * Runs `algorithm` over `segments` repeatedly until at least `minTime` seconds have passed, and records the mean time per
+ * pass. One untimed pass comes first, so that the segments and the sink's memory are in cache.
+ */
+template <typename Sink>
+void runBenchmark(JsonWriter& json, const char* distribution, const char* sinkName, Sink& sink,
+	const Algorithm<Sink>& algorithm, const SegmentSpan& segments, std::size_t pixels, double minTime)
+{
+	using clock = std::chrono::steady_clock;
+	algorithm.draw(sink, segments);
+	int passes = 0;
+	auto start = clock::now();
+	std::chrono::duration<double> elapsed{};
+	do
+	{
+		algorithm.draw(sink, segments);
+		++passes;
+		elapsed = clock::now() - start;
+	}
+	while (elapsed.count() < minTime);
+	json.addResult(distribution, sinkName, algorithm.name, segments.count, pixels, elapsed.count(), passes);
+}
+
+bool parseArguments(int argc, char** argv, Settings& settings)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 == argc)
+			return false;
+		const char* value = argv[++i];
+		if (!std::strcmp(argv[i-1], "--size"))
+			settings.size = std::atoi(value);
+		else if (!std::strcmp(argv[i-1], "--segments"))
+			settings.segments = std::atoi(value);
+		else if (!std::strcmp(argv[i-1], "--min-time"))
+			settings.minTime = std::atof(value);
+		else if (!std::strcmp(argv[i-1], "--seed"))
+			settings.seed = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+		else if (!std::strcmp(argv[i-1], "--distribution"))
+		{
+			if (!findDistribution(value))
+			{
+				std::fprintf(stderr, "unknown distribution: %s\n", value);
+				return false;
+			}
+			settings.distributions.push_back(value);
+		}
+		else if (!std::strcmp(argv[i-1], "--output"))
+			settings.output = value;
+		else
+			return false;
+	}
+	return settings.size > 0 && settings.segments > 0;
+}
+
+int main(int argc, char** argv)
+{
+	Settings settings;
+	if (!parseArguments(argc, argv, settings))
+	{
+		std::fprintf(stderr, "usage: %s [--size n] [--segments n] [--min-time s] [--seed n] [--distribution name]... "
+			"[--output file]\n", argv[0]);
+		return 2;
+	}
+	std::FILE* file = settings.output ? std::fopen(settings.output, "w") : stdout;
+	if (!file)
+		return 1;
+	{
+		JsonWriter json(file, settings);
+		std::mt19937 engine(settings.seed);
+		NullSink nullSink;
+		Framebuffer framebuffer(settings.size, settings.size);
+		for (const Distribution& distribution: k_distributions)
+		{
+			if (!settings.distributions.empty() && std::find(settings.distributions.begin(), settings.distributions.end(),
+				distribution.name) == settings.distributions.end())
+				continue;
+			Segments segments = generateSegments(distribution, settings.size, settings.segments, engine);
+			std::vector<std::size_t> pixels = countPixels(segments.span());
+			std::vector<Algorithm<NullSink>> nullAlgorithms = getAlgorithms<NullSink>();
+			for (std::size_t i = 0; i < nullAlgorithms.size(); ++i)
+			{
+				runBenchmark(json, distribution.name, "null", nullSink, nullAlgorithms[i], segments.span(), pixels[i],
+					settings.minTime);
+			}
+			std::vector<Algorithm<Framebuffer>> framebufferAlgorithms = getAlgorithms<Framebuffer>();
+			for (std::size_t i = 0; i < framebufferAlgorithms.size(); ++i)
+			{
+				runBenchmark(json, distribution.name, "framebuffer", framebuffer, framebufferAlgorithms[i],
+					segments.span(), pixels[i], settings.minTime);
+			}
+		}
+		// Printing the checksum keeps the work done for `nullSink` from being optimized away.
+		std::fprintf(stderr, "null sink checksum: %08x\n", nullSink.getChecksum());
+	}
+	if (settings.output)
+		std::fclose(file);
+	return 0;
+}
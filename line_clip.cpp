@@ -1,9 +1,16 @@
-#include <windows.h>
-#include <GL/glut.h>
+#include "raster.h"
 #include <cmath>
 #include <array>
 #include <vector>
 #include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
 
 using point_t = std::array<int, 2>;
 
@@ -12,86 +19,237 @@ constexpr int k_displayXMax = 300;
 constexpr int k_displayYMin = 0;
 constexpr int k_displayYMax = 300;
 
-double copySignum(double x, double y)
+/*
+ * Performs the Liang–Barsky algorithm on the segment from `p1` to `p2` and the rectangle with corners `min` and `max`,
+ * without drawing anything or allocating memory. If part of the segment with positive length lies in the rectangle, it
+ * runs from parameter `u1` to parameter `u2`, and true is returned.
+ */
+bool clipParameters(const point_t& p1, const point_t& p2, const point_t& min, const point_t& max, double& u1, double& u2)
 {
-	return y ? std::copysign(x, y) : 0.0;
+	// -deltaX, deltaX, -deltaY, deltaY
+	int a[4]{p1[0] - p2[0], p2[0] - p1[0], p1[1] - p2[1], p2[1] - p1[1]};
+	int b[4]{p1[0] - min[0], max[0] - p1[0], p1[1] - min[1], max[1] - p1[1]};
+	u1 = 0.0, u2 = 1.0;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (a[i] < 0)
+			u1 = std::max(u1, static_cast<double>(b[i]) / a[i]);
+		else if (a[i] > 0)
+			u2 = std::min(u2, static_cast<double>(b[i]) / a[i]);
+		// A segment parallel to a side is rejected if it lies outside that side, and otherwise unaffected by it.
+		else if (b[i] < 0)
+			return false;
+	}
+	// If `u1 == u2`, the line need not be drawn, as it would have a length of zero.
+	return u1 < u2;
+}
+
+template <typename Sink>
+void clipLineLiangBarsky(Sink& sink, const point_t& p1, const point_t& p2, const point_t& min, const point_t& max)
+{
+	double u1, u2;
+	if (clipParameters(p1, p2, min, max, u1, u2))
+		lineBresenham(sink, std::lround(p1[0] + u1*(p2[0] - p1[0])), std::lround(p1[1] + u1*(p2[1] - p1[1])),
+			std::lround(p1[0] + u2*(p2[0] - p1[0])), std::lround(p1[1] + u2*(p2[1] - p1[1])));
 }
 
-void lineBresenham(int x1, int y1, int x2, int y2)
+/*
+ * Clips every segment in `segments` to the rectangle with corners `min` and `max`, and stores the parts that survive,
+ * rounded to the nearest pixel, in `out` in their original order. `out` must have room for `segments.count` segments,
+ * and must not overlap `segments`. Returns the number of segments stored. No memory is allocated, and no pixels are
+ * drawn, so clipping can run (and be timed) as a stage of its own in front of `lineBresenham`.
+ *
+ * With AVX, four segments are clipped at a time: the eight ratios of `b` to `a` are computed in double-precision lanes,
+ * and the comparisons in `clipParameters` become masks. The results are the same as those of `clipParameters`.
+ */
+std::size_t clipSegmentsLiangBarsky(const SegmentSpan& segments, const point_t& min, const point_t& max,
+	const SegmentBuffer& out)
 {
-	int deltaX = std::abs(x2 - x1), deltaY = std::abs(y2 - y1);
-	int x = x1, y = y1;
-	int *domainVar, *rangeVar, *domainDelta, *rangeDelta;
-	int domainStep, rangeStep;
-	if (deltaX > deltaY)
+	std::size_t i = 0, count = 0;
+	auto store = [&](std::size_t j, double u1, double u2)
 	{
-		domainVar = &x, rangeVar = &y;
-		domainDelta = &deltaX, rangeDelta = &deltaY;
-		domainStep = static_cast<int>(copySignum(1.0, x2 - x1));
-		rangeStep = static_cast<int>(copySignum(1.0, y2 - y1));
+		int deltaX = segments.x2[j] - segments.x1[j], deltaY = segments.y2[j] - segments.y1[j];
+		out.x1[count] = std::lround(segments.x1[j] + u1*deltaX), out.y1[count] = std::lround(segments.y1[j] + u1*deltaY);
+		out.x2[count] = std::lround(segments.x1[j] + u2*deltaX), out.y2[count] = std::lround(segments.y1[j] + u2*deltaY);
+		++count;
+	};
+#ifdef __AVX__
+	constexpr int k_lanes = 4;
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d xMin = _mm256_set1_pd(min[0]), xMax = _mm256_set1_pd(max[0]);
+	const __m256d yMin = _mm256_set1_pd(min[1]), yMax = _mm256_set1_pd(max[1]);
+	alignas(32) double lower[k_lanes], upper[k_lanes];
+	for (; i + k_lanes <= segments.count; i += k_lanes)
+	{
+		auto load = [i](const int* p){return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));};
+		__m256d x1 = load(segments.x1), y1 = load(segments.y1);
+		__m256d deltaX = _mm256_sub_pd(load(segments.x2), x1), deltaY = _mm256_sub_pd(load(segments.y2), y1);
+		__m256d u1 = zero, u2 = _mm256_set1_pd(1.0), rejected = zero;
+		auto applySide = [&](__m256d a, __m256d b)
+		{
+			__m256d ratio = _mm256_div_pd(b, a);
+			__m256d entering = _mm256_cmp_pd(a, zero, _CMP_LT_OQ), leaving = _mm256_cmp_pd(a, zero, _CMP_GT_OQ);
+			u1 = _mm256_blendv_pd(u1, _mm256_max_pd(u1, ratio), entering);
+			u2 = _mm256_blendv_pd(u2, _mm256_min_pd(u2, ratio), leaving);
+			__m256d outside = _mm256_and_pd(_mm256_cmp_pd(a, zero, _CMP_EQ_OQ), _mm256_cmp_pd(b, zero, _CMP_LT_OQ));
+			rejected = _mm256_or_pd(rejected, outside);
+		};
+		applySide(_mm256_sub_pd(zero, deltaX), _mm256_sub_pd(x1, xMin));
+		applySide(deltaX, _mm256_sub_pd(xMax, x1));
+		applySide(_mm256_sub_pd(zero, deltaY), _mm256_sub_pd(y1, yMin));
+		applySide(deltaY, _mm256_sub_pd(yMax, y1));
+		int accepted = _mm256_movemask_pd(_mm256_andnot_pd(rejected, _mm256_cmp_pd(u1, u2, _CMP_LT_OQ)));
+		if (!accepted)
+			continue;
+		_mm256_store_pd(lower, u1);
+		_mm256_store_pd(upper, u2);
+		for (int lane = 0; lane < k_lanes; ++lane)
+		{
+			if (accepted >> lane & 1)
+				store(i + lane, lower[lane], upper[lane]);
+		}
 	}
-	else
+#endif
+	for (; i < segments.count; ++i)
 	{
-		domainVar = &y, rangeVar = &x;
-		domainDelta = &deltaY, rangeDelta = &deltaX;
-		domainStep = static_cast<int>(copySignum(1.0, y2 - y1));
-		rangeStep = static_cast<int>(copySignum(1.0, x2 - x1));
+		double u1, u2;
+		point_t p1{segments.x1[i], segments.y1[i]}, p2{segments.x2[i], segments.y2[i]};
+		if (clipParameters(p1, p2, min, max, u1, u2))
+			store(i, u1, u2);
 	}
-	int p = 2*(*rangeDelta) - *domainDelta;
-	// `d_lower` and `d_upper` are special cases of `d_same` and `d_changed` for when slope is positive.
-	int same = 2*(*rangeDelta);
-	int changed = same - 2*(*domainDelta);
-	glBegin(GL_POINTS);
-	for (int i = 0; i < *domainDelta; ++i)
+	return count;
+}
+
+// Cohen–Sutherland outcodes: one bit for each side of the clipping rectangle that a point lies beyond.
+constexpr unsigned int k_left = 1;
+constexpr unsigned int k_right = 2;
+constexpr unsigned int k_bottom = 4;
+constexpr unsigned int k_top = 8;
+
+unsigned int outcode(const point_t& p, const point_t& min, const point_t& max)
+{
+	return (p[0] < min[0] ? k_left : 0) | (p[0] > max[0] ? k_right : 0) | (p[1] < min[1] ? k_bottom : 0)
+		| (p[1] > max[1] ? k_top : 0);
+}
+
+/*
+ * Clips the polyline through the `size` points in `vertices` to the rectangle with corners `min` and `max`, and stores the
+ * visible parts of its segments in `out` in the manner of `clipSegmentsLiangBarsky`. If `closed` is true, a final segment
+ * joins the last vertex to the first. `out` must have room for `size` segments. Returns the number of segments stored.
+ *
+ * Every vertex is classified once, and its outcode is reused by both segments that share the vertex. A segment whose
+ * endpoints both have an outcode of zero is accepted as is. A segment whose endpoints share an outcode bit is rejected, so
+ * a stretch of the polyline that stays inside, or beyond any one side, costs a comparison per vertex. Only the segments
+ * that may cross the rectangle's boundary are passed to `clipParameters`.
+ */
+std::size_t clipPolyline(const point_t* vertices, std::size_t size, bool closed, const point_t& min, const point_t& max,
+	const SegmentBuffer& out)
+{
+	if (size < 2)
+		return 0;
+	std::size_t count = 0;
+	auto store = [&](int x1, int y1, int x2, int y2)
+	{
+		out.x1[count] = x1, out.y1[count] = y1, out.x2[count] = x2, out.y2[count] = y2;
+		++count;
+	};
+	unsigned int firstCode = outcode(vertices[0], min, max), previousCode = firstCode;
+	std::size_t segments = closed ? size : size - 1;
+	for (std::size_t i = 1; i <= segments; ++i)
 	{
-		glVertex2i(x, y);
-		*domainVar += domainStep;
-		if (p < 0)
-			p += same;
-		else
+		const point_t &p1 = vertices[i-1], &p2 = i < size ? vertices[i] : vertices[0];
+		unsigned int code = i < size ? outcode(p2, min, max) : firstCode;
+		if (!(previousCode | code))
+			store(p1[0], p1[1], p2[0], p2[1]);
+		else if (!(previousCode & code))
 		{
-			p += changed;
-			*rangeVar += rangeStep;
+			double u1, u2;
+			if (clipParameters(p1, p2, min, max, u1, u2))
+				store(std::lround(p1[0] + u1*(p2[0] - p1[0])), std::lround(p1[1] + u1*(p2[1] - p1[1])),
+					std::lround(p1[0] + u2*(p2[0] - p1[0])), std::lround(p1[1] + u2*(p2[1] - p1[1])));
 		}
+		previousCode = code;
 	}
-	glEnd();
+	return count;
 }
 
-void clipLineLiangBarsky(const point_t& p1, const point_t& p2, const point_t& min, const point_t& max)
+/*
+ * Clips `count` random segments, from ones wholly inside the rectangle to ones wholly outside it, with some parallel to
+ * its sides, both with `clipSegmentsLiangBarsky` and one at a time with `clipParameters`. Prints the segments on which
+ * the two disagree, and returns how many there were.
+ */
+std::size_t checkBatchClip(std::size_t count, unsigned int seed)
 {
-	// -deltaX, deltaX, -deltaY, deltaY
-	int a[4]{p1[0] - p2[0], p2[0] - p1[0], p1[1] - p2[1], p2[1] - p1[1]};
-	int b[4]{p1[0] - min[0], max[0] - p1[0], p1[1] - min[1], max[1] - p1[1]};
-	std::vector<double> outToIn{0.0}, inToOut{1.0};
-	for (int i = 0; i < 4; ++i)
+	constexpr point_t k_min{50, 50}, k_max{250, 250};
+	std::mt19937 engine(seed);
+	std::uniform_int_distribution<int> coord(-100, 400);
+	std::vector<int> x1(count), y1(count), x2(count), y2(count);
+	for (std::size_t i = 0; i < count; ++i)
 	{
-		if (a[i] < 0)
-			outToIn.push_back(static_cast<double>(b[i]) / a[i]);
-		else if (a[i] > 0)
-			inToOut.push_back(static_cast<double>(b[i]) / a[i]);
-		else if (a[i] == 0 && b[i] >= 0)
+		x1[i] = coord(engine), y1[i] = coord(engine), x2[i] = coord(engine), y2[i] = coord(engine);
+		if (i % 8 == 1)
+			x2[i] = x1[i];
+		else if (i % 8 == 2)
+			y2[i] = y1[i];
+	}
+	std::vector<int> outX1(count), outY1(count), outX2(count), outY2(count);
+	std::size_t clipped = clipSegmentsLiangBarsky(SegmentSpan{x1.data(), y1.data(), x2.data(), y2.data(), count}, k_min,
+		k_max, SegmentBuffer{outX1.data(), outY1.data(), outX2.data(), outY2.data()});
+	std::size_t mismatches = 0, j = 0;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		point_t p1{x1[i], y1[i]}, p2{x2[i], y2[i]};
+		double u1, u2;
+		if (!clipParameters(p1, p2, k_min, k_max, u1, u2))
+			continue;
+		std::array<long, 4> expected{std::lround(p1[0] + u1*(p2[0] - p1[0])), std::lround(p1[1] + u1*(p2[1] - p1[1])),
+			std::lround(p1[0] + u2*(p2[0] - p1[0])), std::lround(p1[1] + u2*(p2[1] - p1[1]))};
+		if (j >= clipped || expected != std::array<long, 4>{outX1[j], outY1[j], outX2[j], outY2[j]})
 		{
-			// If a line is parallel to one side of a rectangle, it's parallel to the opposite side as well, so `i` must
-			// equal zero or two.
-			if (i)
-			{
-				auto yVals(std::minmax(p1[1], p2[1]));
-				return lineBresenham(min[0], yVals.first, max[0], yVals.second);
-			}
-			else
-			{
-				auto xVals(std::minmax(p1[0], p2[0]));
-				return lineBresenham(xVals.first, min[1], xVals.second, max[1]);
-			}
+			std::fprintf(stderr, "segment %zu, (%d, %d) to (%d, %d): expected (%ld, %ld) to (%ld, %ld)\n", i,
+				p1[0], p1[1], p2[0], p2[1], expected[0], expected[1], expected[2], expected[3]);
+			++mismatches;
 		}
-		else
-			return;
+		++j;
 	}
-	double u1 = *std::max_element(outToIn.begin(), outToIn.end()), u2 = *std::min_element(inToOut.begin(), inToOut.end());
-	// If `u1 == u2`, the line need not be drawn, as it would have a length of zero.
-	if (u1 < u2)
-		lineBresenham(std::lround(p1[0] + u1*a[1]), std::lround(p1[1] + u1*a[3]), std::lround(p1[0] + u2*a[1]),
-			std::lround(p1[1] + u2*a[3]));
+	if (j != clipped)
+	{
+		std::fprintf(stderr, "%zu segments clipped in the batch, but %zu one at a time\n", clipped, j);
+		++mismatches;
+	}
+	std::printf("%zu segments, %zu visible, %zu mismatches\n", count, j, mismatches);
+	return mismatches;
+}
+
+// The polylines drawn by `customClip` and `batchClip`, and the rectangle they are clipped to.
+struct Polyline
+{
+	const point_t* vertices;
+	std::size_t size;
+	bool closed;
+};
+
+constexpr point_t k_clipMin{0, 45}, k_clipMax{100, 100};
+constexpr point_t k_mountain[7]{{15, 0}, {30, 80}, {38, 40}, {55, 100}, {62, 40}, {75, 80}, {90, 0}};
+constexpr point_t k_snowLine1[3]{{25, 50}, {30, 40}, {35, 50}};
+constexpr point_t k_snowLine2[5]{{40, 50}, {45, 40}, {55, 50}, {57, 40}, {60, 50}};
+constexpr point_t k_snowLine3[3]{{65, 50}, {70, 40}, {80, 50}};
+constexpr Polyline k_scene[4]{{k_mountain, 7, true}, {k_snowLine1, 3, false}, {k_snowLine2, 5, false},
+	{k_snowLine3, 3, false}};
+constexpr int k_maxSegments = 16;
+
+void drawClippedSegments(const SegmentSpan& segments)
+{
+	gluOrtho2D(k_displayXMin, k_displayXMax, k_displayYMin, k_displayYMax);
+	glColor3d(0.0, 0.0, 0.0);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glScaled(2.0, 2.0, 0.0);
+	GLSink sink;
+	sink.begin();
+	for (std::size_t i = 0; i < segments.count; ++i)
+		lineBresenham(sink, segments.x1[i], segments.y1[i], segments.x2[i], segments.y2[i]);
+	sink.end();
 }
 
 // Display functions:
@@ -132,31 +290,42 @@ void builtinClip()
 
 void customClip()
 {
-	static constexpr point_t k_min{0, 45}, k_max{100, 100};
-	static constexpr point_t mountain[7]{{15, 0}, {30, 80}, {38, 40}, {55, 100}, {62, 40}, {75, 80}, {90, 0}};
-	static constexpr point_t snowLine1[3]{{25, 50}, {30, 40}, {35, 50}};
-	static constexpr point_t snowLine2[5]{{40, 50}, {45, 40}, {55, 50}, {57, 40}, {60, 50}};
-	static constexpr point_t snowLine3[3]{{65, 50}, {70, 40}, {80, 50}};
-	
-	gluOrtho2D(k_displayXMin, k_displayXMax, k_displayYMin, k_displayYMax);
-	glColor3d(0.0, 0.0, 0.0);
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	glScaled(2.0, 2.0, 0.0);
-	for (int i = 1; i < 7; ++i)
-		clipLineLiangBarsky(mountain[i-1], mountain[i], k_min, k_max);
-	clipLineLiangBarsky(mountain[6], mountain[0], k_min, k_max);
-	for (int i = 1; i < 3; ++i)
-		clipLineLiangBarsky(snowLine1[i-1], snowLine1[i], k_min, k_max);
-	for (int i = 1; i < 5; ++i)
-		clipLineLiangBarsky(snowLine2[i-1], snowLine2[i], k_min, k_max);
-	for (int i = 1; i < 3; ++i)
-		clipLineLiangBarsky(snowLine3[i-1], snowLine3[i], k_min, k_max);
-	glFlush();
+	int x1[k_maxSegments], y1[k_maxSegments], x2[k_maxSegments], y2[k_maxSegments];
+	std::size_t count = 0;
+	for (const Polyline& polyline: k_scene)
+	{
+		count += clipPolyline(polyline.vertices, polyline.size, polyline.closed, k_clipMin, k_clipMax,
+			SegmentBuffer{x1 + count, y1 + count, x2 + count, y2 + count});
+	}
+	drawClippedSegments(SegmentSpan{x1, y1, x2, y2, count});
+}
+
+// As `customClip`, but with every segment of the polylines clipped in one batch.
+void batchClip()
+{
+	int x1[k_maxSegments], y1[k_maxSegments], x2[k_maxSegments], y2[k_maxSegments];
+	std::size_t count = 0;
+	for (const Polyline& polyline: k_scene)
+	{
+		for (std::size_t i = 0; i < (polyline.closed ? polyline.size : polyline.size - 1); ++i)
+		{
+			const point_t &p1 = polyline.vertices[i], &p2 = polyline.vertices[(i + 1) % polyline.size];
+			x1[count] = p1[0], y1[count] = p1[1], x2[count] = p2[0], y2[count] = p2[1];
+			++count;
+		}
+	}
+	int clippedX1[k_maxSegments], clippedY1[k_maxSegments], clippedX2[k_maxSegments], clippedY2[k_maxSegments];
+	count = clipSegmentsLiangBarsky(SegmentSpan{x1, y1, x2, y2, count}, k_clipMin, k_clipMax,
+		SegmentBuffer{clippedX1, clippedY1, clippedX2, clippedY2});
+	drawClippedSegments(SegmentSpan{clippedX1, clippedY1, clippedX2, clippedY2, count});
 }
 
+// Usage: line_clip [--batch | --check [<segment count>]]
 int main(int argc, char** argv)
 {
+	if (argc >= 2 && !std::strcmp(argv[1], "--check"))
+		return checkBatchClip(argc >= 3 ? std::strtoul(argv[2], nullptr, 10) : 100000, 1) ? 1 : 0;
+	bool batch = argc >= 2 && !std::strcmp(argv[1], "--batch");
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA);
 	glutInitWindowPosition(100, 100);
@@ -166,7 +335,7 @@ int main(int argc, char** argv)
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
 	glClear(GL_COLOR_BUFFER_BIT);
-	glutDisplayFunc(customClip);
+	glutDisplayFunc(batch ? batchClip : customClip);
 	glutMainLoop();
 	return 0;
 }
\ No newline at end of file
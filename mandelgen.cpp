@@ -1,7 +1,24 @@
 #include <complex>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <windows.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 #include "GL/glut.h"
+#include "thread_pool.h"
 
 using std::complex;
 
@@ -10,6 +27,8 @@ const double k_defaultThreshold = 2.0;
 const double k_xMax = 4.0;
 const double k_yMax = 3.0;
 const double k_multiplier = 100.0;
+// The plane is rendered in square tiles of this many points a side.
+const int k_tileSize = 32;
 
 /*
  * Performs a given number of iterations of the function x_(n+1) = (x_n)^2 + z. If the magnitude of x_n exceeds threshold
@@ -27,6 +46,248 @@ int findEscapeTime(complex<double> x, complex<double> z, int iterations, double
 	return -1;
 }
 
+/*
+ * `findEscapeTime` for `count` points at once: `times[i]` is the escape time of the point starting at (`xRes[i]`,
+ * `xIms[i]`) and iterated with (`zRes[i]`, `zIms[i]`). The scalar kernel simply calls `findEscapeTime`, and is the
+ * reference that the vector kernels are checked against.
+ */
+using escapeKernel_t = void (*)(const double* xRes, const double* xIms, const double* zRes, const double* zIms,
+	int count, int iterations, double threshold, int* times);
+
+void findEscapeTimesScalar(const double* xRes, const double* xIms, const double* zRes, const double* zIms, int count,
+	int iterations, double threshold, int* times)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		complex<double> x{xRes[i], xIms[i]}, z{zRes[i], zIms[i]};
+		times[i] = findEscapeTime(x, z, iterations, threshold);
+	}
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MANDELGEN_X86
+
+/*
+ * The vector kernels are compiled for their instruction sets whatever the target of the rest of the program, and are
+ * only called once `cpuSupports` has found those instructions on the machine at run time.
+ */
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+bool cpuSupports(const char* feature)
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	// The OS has to save the wider registers on a context switch, as well as the CPU having them.
+	if (!(info[2] & 1 << 27))
+		return false;
+	unsigned long long enabled = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	if (!std::strcmp(feature, "avx2"))
+		return (enabled & 0x6) == 0x6 && info[1] & 1 << 5;
+	if (!std::strcmp(feature, "avx512f"))
+		return (enabled & 0xE6) == 0xE6 && info[1] & 1 << 16;
+	return false;
+#else
+	__builtin_cpu_init();
+	if (!std::strcmp(feature, "avx2"))
+		return __builtin_cpu_supports("avx2");
+	if (!std::strcmp(feature, "avx512f"))
+		return __builtin_cpu_supports("avx512f");
+	return false;
+#endif
+}
+
+/*
+ * Runs `Kernel::iterate`, which iterates `Kernel::k_lanes` points together, over every point, copying the last few
+ * into full-width buffers so that the kernel only ever sees whole vectors.
+ */
+template <typename Kernel>
+void runInBlocks(const double* xRes, const double* xIms, const double* zRes, const double* zIms, int count,
+	int iterations, double threshold, int* times)
+{
+	constexpr int k_lanes = Kernel::k_lanes;
+	int i = 0;
+	for (; i + k_lanes <= count; i += k_lanes)
+		Kernel::iterate(xRes + i, xIms + i, zRes + i, zIms + i, iterations, threshold, times + i);
+	if (i == count)
+		return;
+	double tail[4][k_lanes];
+	int tailTimes[k_lanes];
+	for (int lane = 0; lane < k_lanes; ++lane)
+	{
+		// Spare lanes repeat the last point, so that they take no longer than it does.
+		int source = std::min(i + lane, count - 1);
+		tail[0][lane] = xRes[source], tail[1][lane] = xIms[source];
+		tail[2][lane] = zRes[source], tail[3][lane] = zIms[source];
+	}
+	Kernel::iterate(tail[0], tail[1], tail[2], tail[3], iterations, threshold, tailTimes);
+	std::copy(tailTimes, tailTimes + (count - i), times + i);
+}
+
+/*
+ * Four points in the lanes of AVX2 registers of doubles. Each step squares and adds exactly as `std::complex<double>`
+ * does, with no fused multiply-adds, so the escape times are the same as the scalar kernel's. A lane that escapes
+ * records the step and is masked off; the loop ends as soon as every lane has escaped.
+ */
+struct AVX2Kernel
+{
+	static constexpr int k_lanes = 4;
+	
+	TARGET_AVX2 static void iterate(const double* xRes, const double* xIms, const double* zRes, const double* zIms,
+		int iterations, double threshold, int* times)
+	{
+		__m256d xRe = _mm256_loadu_pd(xRes), xIm = _mm256_loadu_pd(xIms);
+		const __m256d zRe = _mm256_loadu_pd(zRes), zIm = _mm256_loadu_pd(zIms);
+		const __m256d limit = _mm256_set1_pd(threshold*threshold);
+		// -1 in the lanes still running, and the escape time in the others.
+		__m256i result = _mm256_set1_epi64x(-1);
+		__m256i running = _mm256_set1_epi64x(-1);
+		for (int i = 0; i < iterations; ++i)
+		{
+			__m256d reSquared = _mm256_mul_pd(xRe, xRe), imSquared = _mm256_mul_pd(xIm, xIm);
+			__m256i escaped = _mm256_and_si256(running,
+				_mm256_castpd_si256(_mm256_cmp_pd(_mm256_add_pd(reSquared, imSquared), limit, _CMP_GT_OQ)));
+			result = _mm256_blendv_epi8(result, _mm256_set1_epi64x(i), escaped);
+			running = _mm256_andnot_si256(escaped, running);
+			if (_mm256_testz_si256(running, running))
+				break;
+			__m256d reIm = _mm256_mul_pd(xRe, xIm);
+			xRe = _mm256_add_pd(_mm256_sub_pd(reSquared, imSquared), zRe);
+			xIm = _mm256_add_pd(_mm256_add_pd(reIm, reIm), zIm);
+		}
+		alignas(32) long long lanes[k_lanes];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), result);
+		for (int lane = 0; lane < k_lanes; ++lane)
+			times[lane] = static_cast<int>(lanes[lane]);
+	}
+};
+
+// As `AVX2Kernel`, for eight points in AVX-512 registers, with the lanes still running kept in a mask register.
+struct AVX512Kernel
+{
+	static constexpr int k_lanes = 8;
+	
+	TARGET_AVX512 static void iterate(const double* xRes, const double* xIms, const double* zRes, const double* zIms,
+		int iterations, double threshold, int* times)
+	{
+		__m512d xRe = _mm512_loadu_pd(xRes), xIm = _mm512_loadu_pd(xIms);
+		const __m512d zRe = _mm512_loadu_pd(zRes), zIm = _mm512_loadu_pd(zIms);
+		const __m512d limit = _mm512_set1_pd(threshold*threshold);
+		__m512i result = _mm512_set1_epi32(-1);
+		__mmask8 running = 0xFF;
+		for (int i = 0; i < iterations; ++i)
+		{
+			__m512d reSquared = _mm512_mul_pd(xRe, xRe), imSquared = _mm512_mul_pd(xIm, xIm);
+			__m512d norm = _mm512_add_pd(reSquared, imSquared);
+			__mmask8 escaped = _mm512_mask_cmp_pd_mask(running, norm, limit, _CMP_GT_OQ);
+			result = _mm512_mask_set1_epi32(result, escaped, i);
+			running = static_cast<__mmask8>(running & ~escaped);
+			if (!running)
+				break;
+			__m512d reIm = _mm512_mul_pd(xRe, xIm);
+			xRe = _mm512_add_pd(_mm512_sub_pd(reSquared, imSquared), zRe);
+			xIm = _mm512_add_pd(_mm512_add_pd(reIm, reIm), zIm);
+		}
+		// Only the low eight of the sixteen 32-bit lanes are used.
+		_mm512_mask_storeu_epi32(times, 0xFF, result);
+	}
+};
+
+/*
+ * Eight points in AVX2 registers of floats. This is twice as wide as `AVX2Kernel`, but single precision loses detail
+ * when zoomed in and can change the escape time of points near the edge of the set, so it is only used when asked for.
+ */
+struct AVX2FloatKernel
+{
+	static constexpr int k_lanes = 8;
+	
+	TARGET_AVX2 static __m256 load(const double* values)
+	{
+		__m128 low = _mm256_cvtpd_ps(_mm256_loadu_pd(values)), high = _mm256_cvtpd_ps(_mm256_loadu_pd(values + 4));
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+	}
+	
+	TARGET_AVX2 static void iterate(const double* xRes, const double* xIms, const double* zRes, const double* zIms,
+		int iterations, double threshold, int* times)
+	{
+		__m256 xRe = load(xRes), xIm = load(xIms);
+		const __m256 zRe = load(zRes), zIm = load(zIms);
+		const __m256 limit = _mm256_set1_ps(static_cast<float>(threshold*threshold));
+		__m256i result = _mm256_set1_epi32(-1);
+		__m256i running = _mm256_set1_epi32(-1);
+		for (int i = 0; i < iterations; ++i)
+		{
+			__m256 reSquared = _mm256_mul_ps(xRe, xRe), imSquared = _mm256_mul_ps(xIm, xIm);
+			__m256i escaped = _mm256_and_si256(running,
+				_mm256_castps_si256(_mm256_cmp_ps(_mm256_add_ps(reSquared, imSquared), limit, _CMP_GT_OQ)));
+			result = _mm256_blendv_epi8(result, _mm256_set1_epi32(i), escaped);
+			running = _mm256_andnot_si256(escaped, running);
+			if (_mm256_testz_si256(running, running))
+				break;
+			__m256 reIm = _mm256_mul_ps(xRe, xIm);
+			xRe = _mm256_add_ps(_mm256_sub_ps(reSquared, imSquared), zRe);
+			xIm = _mm256_add_ps(_mm256_add_ps(reIm, reIm), zIm);
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(times), result);
+	}
+};
+#endif
+
+struct EscapeKernel
+{
+	const char* name;
+	escapeKernel_t find;
+	// The CPU feature the kernel needs, if any.
+	const char* feature;
+	// Whether the kernel gives the same escape times as the scalar reference, and so may be picked without being asked
+	// for.
+	bool exact;
+};
+
+// In order of preference.
+const EscapeKernel k_escapeKernels[]
+{
+#ifdef MANDELGEN_X86
+	{"avx512", runInBlocks<AVX512Kernel>, "avx512f", true},
+	{"avx2", runInBlocks<AVX2Kernel>, "avx2", true},
+	{"avx2-float", runInBlocks<AVX2FloatKernel>, "avx2", false},
+#endif
+	{"scalar", findEscapeTimesScalar, nullptr, true}
+};
+
+/*
+ * The kernel called `name`, if the machine supports it, or with a null `name`, the first exact kernel that it
+ * supports. Returns null if there is no such kernel.
+ */
+const EscapeKernel* chooseEscapeKernel(const char* name)
+{
+	for (const EscapeKernel& kernel: k_escapeKernels)
+	{
+		if (name ? std::strcmp(kernel.name, name) != 0 : !kernel.exact)
+			continue;
+#ifdef MANDELGEN_X86
+		if (kernel.feature && !cpuSupports(kernel.feature))
+			continue;
+#endif
+		return &kernel;
+	}
+	return nullptr;
+}
+
+const EscapeKernel* currentKernel = chooseEscapeKernel(nullptr);
+
+unsigned int renderThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
 void drawPoint(double x, double y, int escapeTime, int iterations)
 {
 	double shade = static_cast<double>(escapeTime == -1 ? 0 : iterations - escapeTime) / iterations;
@@ -34,32 +295,89 @@ void drawPoint(double x, double y, int escapeTime, int iterations)
 	glVertex2d(k_multiplier * x, k_multiplier * y);
 }
 
-void mandelbrot(int iterations, double threshold)
+// The values that the loops over x and y step through, added up the same way so that the points are exactly the same.
+std::vector<double> getSteps(double max)
 {
+	std::vector<double> steps;
 	double delta = 1 / k_multiplier;
-	for (double x = -k_xMax; x <= k_xMax; x += delta)
+	for (double value = -max; value <= max; value += delta)
+		steps.push_back(value);
+	return steps;
+}
+
+void reportRenderStats(const ThreadPool& pool, std::size_t tileCount)
+{
+	double seconds = pool.getLoopSeconds();
+	std::fprintf(stderr, "%zu tiles rendered by %u threads in %.1f ms\n", tileCount, pool.getThreadCount(),
+		seconds*1000);
+	for (unsigned int i = 0; i < pool.getThreadCount(); ++i)
 	{
-		for (double y = -k_yMax; y <= k_yMax; y += delta)
-		{
-			int escapeTime = findEscapeTime(complex<double>{}, complex<double>{x, y}, iterations, threshold);
-			drawPoint(x, y, escapeTime, iterations);
-		}
+		const ThreadPool::WorkerStats& stats = pool.getWorkerStats(i);
+		std::fprintf(stderr, "  thread %u: %5.1f%% busy, %zu tiles, %zu steals\n", i,
+			seconds > 0 ? 100*stats.busySeconds / seconds : 0.0, stats.indices, stats.steals);
 	}
 }
 
-void julia(complex<double> z, int iterations, double threshold)
+/*
+ * Finds the escape time of every point of the plane into `times`, column by column. The plane is cut into tiles
+ * of `k_tileSize` by `k_tileSize` points, which are shared out among the threads by work stealing, since the cost of a
+ * tile ranges from a few iterations a point outside the set to the full count inside it. Within a tile, the escape
+ * times of each column are found together by `currentKernel`; for the Mandelbrot set each point is the constant `z`
+ * and iteration starts from 0, while for a Julia set each point is the starting value and `z` is the same for all of
+ * them.
+ */
+void renderEscapeTimes(const std::vector<double>& xs, const std::vector<double>& ys, bool isJulia, complex<double> z,
+	int iterations, double threshold, std::vector<int>& times)
 {
-	double delta = 1 / k_multiplier;
-	for (double x = -k_xMax; x <= k_xMax; x += delta)
+	static ThreadPool pool(renderThreadCount);
+	int columns = static_cast<int>(xs.size()), rows = static_cast<int>(ys.size());
+	int tileColumns = (columns + k_tileSize - 1) / k_tileSize, tileRows = (rows + k_tileSize - 1) / k_tileSize;
+	times.resize(xs.size()*ys.size());
+	pool.parallelForStealing(static_cast<std::size_t>(tileColumns)*tileRows, [&](std::size_t tile)
 	{
-		for (double y = -k_yMax; y <= k_yMax; y += delta)
+		int x0 = static_cast<int>(tile / tileRows)*k_tileSize, y0 = static_cast<int>(tile % tileRows)*k_tileSize;
+		int count = std::min(k_tileSize, rows - y0);
+		std::array<double, k_tileSize> columnXs, constantRes, constantIms;
+		constantRes.fill(isJulia ? z.real() : 0.0);
+		constantIms.fill(isJulia ? z.imag() : 0.0);
+		for (int column = x0; column < std::min(x0 + k_tileSize, columns); ++column)
 		{
-			int escapeTime = findEscapeTime(complex<double>{x, y}, z, iterations, threshold);
-			drawPoint(x, y, escapeTime, iterations);
+			columnXs.fill(xs[column]);
+			const double *xRes = columnXs.data(), *xIms = ys.data() + y0;
+			const double *zRes = constantRes.data(), *zIms = constantIms.data();
+			if (!isJulia)
+				std::swap(xRes, zRes), std::swap(xIms, zIms);
+			currentKernel->find(xRes, xIms, zRes, zIms, count, iterations, threshold,
+				times.data() + static_cast<std::size_t>(column)*rows + y0);
 		}
+	});
+	reportRenderStats(pool, static_cast<std::size_t>(tileColumns)*tileRows);
+}
+
+// Renders the escape times of every point of the plane, then draws them.
+void drawEscapeTimes(bool isJulia, complex<double> z, int iterations, double threshold)
+{
+	static const std::vector<double> xs = getSteps(k_xMax), ys = getSteps(k_yMax);
+	static std::vector<int> times;
+	renderEscapeTimes(xs, ys, isJulia, z, iterations, threshold, times);
+	const int* time = times.data();
+	for (double x: xs)
+	{
+		for (double y: ys)
+			drawPoint(x, y, *time++, iterations);
 	}
 }
 
+void mandelbrot(int iterations, double threshold)
+{
+	drawEscapeTimes(false, complex<double>{}, iterations, threshold);
+}
+
+void julia(complex<double> z, int iterations, double threshold)
+{
+	drawEscapeTimes(true, z, iterations, threshold);
+}
+
 void init()
 {
 	glClearColor(1.0, 1.0, 1.0, 1.0);
@@ -103,9 +421,24 @@ void drawJuliaC()
 	glFlush();
 }
 
+// Usage: mandelgen [--kernel avx512|avx2|avx2-float|scalar] [--threads n]
 int main(int argc, char **argv)
 {
 	glutInit(&argc, argv);
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (!std::strcmp(argv[i], "--kernel"))
+		{
+			currentKernel = chooseEscapeKernel(argv[i + 1]);
+			if (!currentKernel)
+			{
+				std::fprintf(stderr, "the %s kernel is not available on this machine\n", argv[i + 1]);
+				return 2;
+			}
+		}
+		else if (!std::strcmp(argv[i], "--threads"))
+			renderThreadCount = static_cast<unsigned int>(std::max(std::atoi(argv[i + 1]), 1));
+	}
 	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
 	glutInitWindowPosition(100, 100);
 	glutInitWindowSize(k_xMax * k_multiplier * 2, k_yMax * k_multiplier * 2);
@@ -1,7 +1,12 @@
 #include <windows.h>
 #include <GL/glut.h>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 constexpr int k_width = 300;
 constexpr int k_height = 300;
@@ -9,38 +14,33 @@ constexpr int k_windowPosX = 100;
 constexpr int k_windowPosY = 100;
 constexpr double k_ringColors[5][3]{{0.0, 0.0, 1.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}};
 
-void drawInQuadrants(int centerX, int centerY, int x, int y)
+/*
+ * The offsets from the centre of the points of a midpoint circle or ellipse that lie in the first quadrant, in the order
+ * they are plotted, as x, y pairs. Each is drawn in all four quadrants.
+ */
+void findCircleOffsets(int radius, std::vector<int>& offsets)
 {
-	glVertex2i(centerX + x, centerY + y);
-	glVertex2i(centerX - x, centerY + y);
-	glVertex2i(centerX - x, centerY - y);
-	glVertex2i(centerX + x, centerY - y);
-}
-
-void drawCircle(const int center[2], int radius, const double color[3])
-{
-	glColor3d(color[0], color[1], color[2]);
+	offsets.clear();
 	int x = 0, y = radius, p = 1 - radius;
 	while (x < y)
 	{
-		drawInQuadrants(center[0], center[1], x, y);
-		drawInQuadrants(center[0], center[1], y, x);
+		offsets.insert(offsets.end(), {x, y, y, x});
 		p += 2*++x + 1;
 		if (p >= 0)
 			p -= 2*--y;
 	}
 }
 
-void drawEllipse(const int center[2], int radiusX, int radiusY, const double color[3])
+void findEllipseOffsets(int radiusX, int radiusY, std::vector<int>& offsets)
 {
-	glColor3d(color[0], color[1], color[2]);
+	offsets.clear();
 	int rxSquared = radiusX*radiusX, rySquared = radiusY*radiusY;
 	int rxSquaredTimesTwo = 2*rxSquared, rySquaredTimesTwo = 2*rySquared;
 	int x = 0, y = radiusY;
 	int p = static_cast<int>(std::round(rySquared - rxSquared*radiusY + 0.25*rxSquared));
 	while (rySquaredTimesTwo*x < rxSquaredTimesTwo*y)
 	{
-		drawInQuadrants(center[0], center[1], x, y);
+		offsets.insert(offsets.end(), {x, y});
 		p += rySquaredTimesTwo*++x + rySquared;
 		if (p >= 0)
 			p -= rxSquaredTimesTwo*--y;
@@ -48,13 +48,125 @@ void drawEllipse(const int center[2], int radiusX, int radiusY, const double col
 	p = static_cast<int>(std::round(rySquared*(x*x + x + 0.25) + rxSquared*(y*y - 2*y + 1) - rxSquared*rySquared));
 	while (y > 0)
 	{
-		drawInQuadrants(center[0], center[1], x, y);
+		offsets.insert(offsets.end(), {x, y});
 		p += rxSquared - rxSquaredTimesTwo*--y;
 		if (p <= 0)
 			p += rySquaredTimesTwo*++x;
 	}
 }
 
+/*
+ * The offsets of the circles and ellipses drawn most recently, so that drawing the same shape again skips the midpoint
+ * recurrence. It holds at most `capacity` shapes and drops the one used least recently to make room for another; the
+ * storage of the dropped shape is reused, so once the cache is full, misses allocate only when a shape is larger than any
+ * before it.
+ */
+class OffsetCache
+{
+	private:
+		struct Entry
+		{
+			// A `radiusY` of -1 marks a circle.
+			int radiusX;
+			int radiusY;
+			unsigned long long lastUse;
+			std::vector<int> offsets;
+		};
+		
+		std::vector<Entry> m_entries;
+		std::size_t m_capacity;
+		unsigned long long m_clock = 0;
+		
+		Entry& find(int radiusX, int radiusY)
+		{
+			Entry* oldest = nullptr;
+			for (Entry& entry: m_entries)
+			{
+				if (entry.radiusX == radiusX && entry.radiusY == radiusY)
+				{
+					entry.lastUse = ++m_clock;
+					return entry;
+				}
+				if (!oldest || entry.lastUse < oldest->lastUse)
+					oldest = &entry;
+			}
+			if (m_entries.size() < m_capacity)
+			{
+				m_entries.push_back({});
+				oldest = &m_entries.back();
+			}
+			oldest->radiusX = radiusX, oldest->radiusY = radiusY, oldest->lastUse = ++m_clock;
+			if (radiusY < 0)
+				findCircleOffsets(radiusX, oldest->offsets);
+			else
+				findEllipseOffsets(radiusX, radiusY, oldest->offsets);
+			return *oldest;
+		}
+		
+	public:
+		explicit OffsetCache(std::size_t capacity = 64): m_capacity(std::max<std::size_t>(capacity, 1))
+		{
+			m_entries.reserve(m_capacity);
+		}
+		
+		const std::vector<int>& getCircle(int radius) {return find(radius, -1).offsets;}
+		const std::vector<int>& getEllipse(int radiusX, int radiusY) {return find(radiusX, radiusY).offsets;}
+};
+
+OffsetCache& getOffsetCache()
+{
+	static OffsetCache cache;
+	return cache;
+}
+
+/*
+ * Draws the points at `offsets` from the centre in all four quadrants with a single `glDrawArrays`. With AVX2, the four
+ * points of an offset are made at once: the x, y pair is repeated four times across a register, the signs of each
+ * quadrant are applied, and the centre is added.
+ */
+void drawInQuadrants(const int center[2], const std::vector<int>& offsets)
+{
+	static std::vector<int> vertices;
+	std::size_t count = offsets.size() / 2;
+	vertices.resize(8*count);
+	std::size_t i = 0;
+#ifdef __AVX2__
+	const __m256i signs = _mm256_setr_epi32(1, 1, -1, 1, -1, -1, 1, -1);
+	const __m256i centers = _mm256_setr_epi32(center[0], center[1], center[0], center[1], center[0], center[1], center[0],
+		center[1]);
+	for (; i < count; ++i)
+	{
+		long long pair;
+		std::memcpy(&pair, &offsets[2*i], sizeof pair);
+		__m256i points = _mm256_add_epi32(centers, _mm256_sign_epi32(_mm256_set1_epi64x(pair), signs));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&vertices[8*i]), points);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		int x = offsets[2*i], y = offsets[2*i + 1];
+		int quadrants[8]{center[0] + x, center[1] + y, center[0] - x, center[1] + y, center[0] - x, center[1] - y,
+			center[0] + x, center[1] - y};
+		std::copy(quadrants, quadrants + 8, &vertices[8*i]);
+	}
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_INT, 0, vertices.data());
+	glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(4*count));
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void drawCircle(const int center[2], int radius, const double color[3])
+{
+	glColor3d(color[0], color[1], color[2]);
+	drawInQuadrants(center, getOffsetCache().getCircle(radius));
+}
+
+void drawEllipse(const int center[2], int radiusX, int radiusY, const double color[3])
+{
+	glColor3d(color[0], color[1], color[2]);
+	drawInQuadrants(center, getOffsetCache().getEllipse(radiusX, radiusY));
+}
+
 void init()
 {
 	glClearColor(1.0, 1.0, 1.0, 0.0);
@@ -68,7 +180,6 @@ void init()
 
 void drawOlympicRingsAsCircles()
 {
-	glBegin(GL_POINTS);
 	int radius = std::min(k_width, k_height) / 6;
 	int center[2];
 	for (int i = 0; i < 5; ++i)
@@ -77,13 +188,11 @@ void drawOlympicRingsAsCircles()
 		center[0] = (i + 1)*radius, center[1] = 3*k_height/4 - (i % 2)*k_height/4;
 		drawCircle(center, radius, k_ringColors[i]);
 	}
-	glEnd();
 	glFlush();
 }
 
 void drawOlympicRingsAsEllipses()
 {
-	glBegin(GL_POINTS);
 	int scale = std::min(k_width, k_height);
 	int radiusX = scale / 6, radiusY = scale / 8;
 	int center[2];
@@ -93,7 +202,6 @@ void drawOlympicRingsAsEllipses()
 		center[0] = (i + 1)*radiusX, center[1] = 3*k_height/4 - (i % 2)*k_height/5;
 		drawEllipse(center, radiusX, radiusY, k_ringColors[i]);
 	}
-	glEnd();
 	glFlush();
 }
 
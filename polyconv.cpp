@@ -0,0 +1,133 @@
+#include "polygon_dataset.h"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+/*
+ * Converts polygons from text to the binary dataset read by `scanfill --dataset`. Each line of the text holds one
+ * polygon: its colour as exactly six hex digits, rrggbb, then the x and y of each of its vertices in pixels, which may
+ * have a fractional part. The last vertex joins back up to the first. Blank lines and lines starting with '#' are
+ * skipped.
+ *
+ *     # A red triangle
+ *     ff0000 10 10 100 10 55.5 90
+ *
+ * Lines are read and written one at a time, so a text file of any size can be converted.
+ *
+ * Usage: polyconv <input.txt> <output.pld>
+ */
+
+constexpr int k_subpixelBits = 4;
+
+// Reads one line of any length into `line`, without its newline. Returns false at the end of the file.
+bool readLine(std::FILE* file, std::string& line)
+{
+	line.clear();
+	char buffer[4096];
+	while (std::fgets(buffer, sizeof buffer, file))
+	{
+		line += buffer;
+		if (line.back() == '\n')
+		{
+			line.pop_back();
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			return true;
+		}
+	}
+	return !line.empty();
+}
+
+// Parses a polygon into `sides`, in units of 1/2^`k_subpixelBits` pixel. Returns false if the line is malformed.
+bool parsePolygon(const char* text, unsigned int& color, std::vector<std::array<int, 4>>& sides)
+{
+	// `strtoul` alone would also take a sign or a 0x prefix.
+	for (int i = 0; i < 6; ++i)
+	{
+		if (!std::isxdigit(static_cast<unsigned char>(text[i])))
+			return false;
+	}
+	char* end;
+	unsigned long rgb = std::strtoul(text, &end, 16);
+	if (end - text != 6 || (*end != ' ' && *end != '\t'))
+		return false;
+	color = (rgb >> 16 & 0xFF) | (rgb & 0xFF00) | (rgb & 0xFF) << 16 | 0xFF000000;
+	std::vector<int> coords;
+	for (text = end;;)
+	{
+		double value = std::strtod(text, &end);
+		if (end == text)
+			break;
+		// `strtod` also takes inf and nan.
+		double scaled = std::round(value*(1 << k_subpixelBits));
+		if (!std::isfinite(scaled) || std::fabs(scaled) > std::numeric_limits<int>::max())
+			return false;
+		coords.push_back(static_cast<int>(scaled));
+		text = end;
+	}
+	while (*end == ' ' || *end == '\t')
+		++end;
+	if (*end || coords.size() % 2 || coords.size() < 6)
+		return false;
+	sides.clear();
+	for (std::size_t i = 0; i < coords.size(); i += 2)
+	{
+		std::size_t next = (i + 2) % coords.size();
+		sides.push_back({coords[i], coords[i + 1], coords[next], coords[next + 1]});
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::fprintf(stderr, "usage: %s <input.txt> <output.pld>\n", argv[0]);
+		return 2;
+	}
+	std::FILE* input = std::fopen(argv[1], "r");
+	if (!input)
+	{
+		std::fprintf(stderr, "%s: cannot open %s\n", argv[0], argv[1]);
+		return 1;
+	}
+	PolygonDatasetWriter writer;
+	if (!writer.open(argv[2], k_subpixelBits))
+	{
+		std::fprintf(stderr, "%s: cannot create %s\n", argv[0], argv[2]);
+		std::fclose(input);
+		return 1;
+	}
+	std::string line;
+	std::vector<std::array<int, 4>> sides;
+	unsigned long lineNumber = 0, polygonCount = 0;
+	while (readLine(input, line))
+	{
+		++lineNumber;
+		std::size_t first = line.find_first_not_of(" \t");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+		unsigned int color;
+		if (!parsePolygon(line.c_str() + first, color, sides))
+		{
+			std::fprintf(stderr, "%s:%lu: expected rrggbb followed by at least three x y pairs of finite numbers\n",
+				argv[1], lineNumber);
+			std::fclose(input);
+			return 1;
+		}
+		writer.addPolygon(sides, color);
+		++polygonCount;
+	}
+	std::fclose(input);
+	if (!writer.close())
+	{
+		std::fprintf(stderr, "%s: error writing %s\n", argv[0], argv[2]);
+		return 1;
+	}
+	std::fprintf(stderr, "%lu polygons written to %s\n", polygonCount, argv[2]);
+	return 0;
+}
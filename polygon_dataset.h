@@ -0,0 +1,334 @@
+#ifndef POLYGON_DATASET_H
+#define POLYGON_DATASET_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * A binary file of filled polygons, laid out so that it can be memory-mapped and read one polygon at a time:
+ *
+ *     header | sides | index
+ *
+ * The header is a `PolygonDatasetHeader`. The sides follow it directly, polygon after polygon, each four 32-bit integers
+ * {x1, y1, x2, y2} in units of 1/2^`subpixelBits` pixel, so that a polygon's sides can be handed to a filler straight from
+ * the mapping. The index comes last, one `PolygonIndexEntry` per polygon, so that a writer can stream sides to the file
+ * without knowing in advance how many there will be. Every field is little-endian, as on the machines this is built for.
+ */
+struct PolygonDatasetHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t subpixelBits;
+	std::uint32_t reserved;
+	std::uint64_t polygonCount;
+	// The byte offset of the index; the sides run from the end of the header up to here.
+	std::uint64_t indexOffset;
+};
+
+struct PolygonIndexEntry
+{
+	// In sides, counted from the first side in the file.
+	std::uint64_t firstSide;
+	std::uint32_t sideCount;
+	// Packed as by `packColor`.
+	std::uint32_t color;
+};
+
+static_assert(sizeof(PolygonDatasetHeader) == 32, "the header is 32 bytes on disk");
+static_assert(sizeof(PolygonIndexEntry) == 16, "an index entry is 16 bytes on disk");
+static_assert(sizeof(std::array<std::int32_t, 4>) == 16, "sides are read in place from the mapping");
+
+constexpr char k_datasetMagic[4] = {'P', 'L', 'Y', 'D'};
+constexpr std::uint32_t k_datasetVersion = 1;
+
+/*
+ * A read-only view of part of a file, moved around the file on demand. `get` returns a pointer to a range of bytes,
+ * mapping a new window around it only when it is not already in the current one. Windows are `windowSize` bytes unless a
+ * single range needs more, so the memory in use stays the same however large the file is.
+ */
+class MappedWindow
+{
+	private:
+#ifdef _WIN32
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+#else
+		int m_file = -1;
+#endif
+		std::uint64_t m_fileSize = 0;
+		std::uint64_t m_granularity = 1;
+		std::size_t m_windowSize;
+		unsigned char* m_view = nullptr;
+		std::uint64_t m_viewOffset = 0;
+		std::size_t m_viewLength = 0;
+		
+		void unmap()
+		{
+			if (!m_view)
+				return;
+#ifdef _WIN32
+			UnmapViewOfFile(m_view);
+#else
+			munmap(m_view, m_viewLength);
+#endif
+			m_view = nullptr, m_viewLength = 0;
+		}
+		
+		void close()
+		{
+			unmap();
+#ifdef _WIN32
+			if (m_mapping)
+				CloseHandle(m_mapping), m_mapping = nullptr;
+			if (m_file != INVALID_HANDLE_VALUE)
+				CloseHandle(m_file), m_file = INVALID_HANDLE_VALUE;
+#else
+			if (m_file >= 0)
+				::close(m_file), m_file = -1;
+#endif
+			m_fileSize = 0;
+		}
+		
+	public:
+		explicit MappedWindow(std::size_t windowSize = 16 << 20): m_windowSize(windowSize) {}
+		
+		MappedWindow(const MappedWindow&) = delete;
+		MappedWindow& operator=(const MappedWindow&) = delete;
+		
+		~MappedWindow() {close();}
+		
+		bool open(const char* path)
+		{
+			close();
+#ifdef _WIN32
+			m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			LARGE_INTEGER size;
+			if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size))
+				return close(), false;
+			m_fileSize = static_cast<std::uint64_t>(size.QuadPart);
+			// An empty file cannot be mapped, but then there is nothing to read either.
+			if (m_fileSize)
+			{
+				m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (!m_mapping)
+					return close(), false;
+			}
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			m_granularity = info.dwAllocationGranularity;
+#else
+			m_file = ::open(path, O_RDONLY);
+			struct stat status;
+			if (m_file < 0 || fstat(m_file, &status))
+				return close(), false;
+			m_fileSize = static_cast<std::uint64_t>(status.st_size);
+			m_granularity = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+			return true;
+		}
+		
+		std::uint64_t getFileSize() const {return m_fileSize;}
+		
+		// The `length` bytes at `offset`, valid until the next call, or null if they run past the end of the file.
+		const unsigned char* get(std::uint64_t offset, std::size_t length)
+		{
+			if (offset > m_fileSize || length > m_fileSize - offset)
+				return nullptr;
+			if (!m_view || offset < m_viewOffset || offset + length > m_viewOffset + m_viewLength)
+			{
+				unmap();
+				// Views have to start on a multiple of the granularity.
+				std::uint64_t start = offset / m_granularity * m_granularity;
+				std::uint64_t stop = std::min<std::uint64_t>(std::max<std::uint64_t>(start + m_windowSize, offset + length),
+					m_fileSize);
+				std::size_t viewLength = static_cast<std::size_t>(stop - start);
+#ifdef _WIN32
+				void* view = MapViewOfFile(m_mapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32),
+					static_cast<DWORD>(start), viewLength);
+				if (!view)
+					return nullptr;
+#else
+				void* view = mmap(nullptr, viewLength, PROT_READ, MAP_SHARED, m_file, static_cast<off_t>(start));
+				if (view == MAP_FAILED)
+					return nullptr;
+				// Polygons are read front to back.
+				madvise(view, viewLength, MADV_SEQUENTIAL);
+#endif
+				m_view = static_cast<unsigned char*>(view), m_viewOffset = start, m_viewLength = viewLength;
+			}
+			return m_view + (offset - m_viewOffset);
+		}
+};
+
+/*
+ * Reads polygons from a dataset one at a time through two windows on the file, one moving through the index and one
+ * through the sides. Nothing is copied: `read` gives out pointers into the mapping.
+ */
+class PolygonDatasetReader
+{
+	private:
+		MappedWindow m_index;
+		MappedWindow m_sides;
+		PolygonDatasetHeader m_header{};
+		std::uint64_t m_totalSides = 0;
+		
+	public:
+		struct Polygon
+		{
+			const std::array<int, 4>* sides;
+			std::size_t sideCount;
+			unsigned int color;
+		};
+		
+		// Opens and checks a dataset. On failure the reader holds no polygons.
+		bool open(const char* path)
+		{
+			m_header = PolygonDatasetHeader{};
+			m_totalSides = 0;
+			if (!m_index.open(path) || !m_sides.open(path))
+				return false;
+			const unsigned char* bytes = m_index.get(0, sizeof m_header);
+			if (!bytes)
+				return false;
+			PolygonDatasetHeader header;
+			std::memcpy(&header, bytes, sizeof header);
+			std::uint64_t fileSize = m_index.getFileSize();
+			if (std::memcmp(header.magic, k_datasetMagic, 4) || header.version != k_datasetVersion
+				|| header.indexOffset < sizeof header || header.indexOffset > fileSize
+				|| (header.indexOffset - sizeof header) % sizeof(std::array<int, 4>)
+				|| header.polygonCount > (fileSize - header.indexOffset) / sizeof(PolygonIndexEntry))
+				return false;
+			m_header = header;
+			m_totalSides = (header.indexOffset - sizeof header) / sizeof(std::array<int, 4>);
+			return true;
+		}
+		
+		std::uint64_t getPolygonCount() const {return m_header.polygonCount;}
+		int getSubpixelBits() const {return static_cast<int>(m_header.subpixelBits);}
+		
+		// Polygon `i`, whose sides stay valid until the next call. Returns false if its entry points outside the file.
+		bool read(std::uint64_t i, Polygon& polygon)
+		{
+			if (i >= m_header.polygonCount)
+				return false;
+			const unsigned char* bytes = m_index.get(m_header.indexOffset + i*sizeof(PolygonIndexEntry),
+				sizeof(PolygonIndexEntry));
+			if (!bytes)
+				return false;
+			PolygonIndexEntry entry;
+			std::memcpy(&entry, bytes, sizeof entry);
+			if (entry.firstSide > m_totalSides || entry.sideCount > m_totalSides - entry.firstSide)
+				return false;
+			std::size_t length = entry.sideCount*sizeof(std::array<int, 4>);
+			bytes = m_sides.get(sizeof m_header + entry.firstSide*sizeof(std::array<int, 4>), length);
+			if (!bytes && length)
+				return false;
+			polygon.sides = reinterpret_cast<const std::array<int, 4>*>(bytes);
+			polygon.sideCount = entry.sideCount;
+			polygon.color = entry.color;
+			return true;
+		}
+};
+
+/*
+ * Writes a dataset front to back. Sides go straight to the file and index entries to a temporary file, which is appended
+ * when the dataset is closed, so memory use does not grow with the number of polygons.
+ */
+class PolygonDatasetWriter
+{
+	private:
+		std::FILE* m_file = nullptr;
+		std::FILE* m_index = nullptr;
+		PolygonDatasetHeader m_header{};
+		std::uint64_t m_sideCount = 0;
+		bool m_failed = false;
+		
+		void discard()
+		{
+			if (m_index)
+				std::fclose(m_index), m_index = nullptr;
+			if (m_file)
+				std::fclose(m_file), m_file = nullptr;
+		}
+		
+	public:
+		PolygonDatasetWriter() = default;
+		PolygonDatasetWriter(const PolygonDatasetWriter&) = delete;
+		PolygonDatasetWriter& operator=(const PolygonDatasetWriter&) = delete;
+		
+		~PolygonDatasetWriter() {discard();}
+		
+		bool open(const char* path, int subpixelBits)
+		{
+			discard();
+			m_file = std::fopen(path, "wb");
+			m_index = std::tmpfile();
+			if (!m_file || !m_index)
+				return discard(), false;
+			m_header = PolygonDatasetHeader{};
+			std::memcpy(m_header.magic, k_datasetMagic, 4);
+			m_header.version = k_datasetVersion;
+			m_header.subpixelBits = static_cast<std::uint32_t>(subpixelBits);
+			m_sideCount = 0;
+			// The header is written again once the counts are known.
+			m_failed = std::fwrite(&m_header, sizeof m_header, 1, m_file) != 1;
+			return !m_failed;
+		}
+		
+		void addPolygon(const std::array<int, 4>* sides, std::size_t count, unsigned int color)
+		{
+			PolygonIndexEntry entry{m_sideCount, static_cast<std::uint32_t>(count), color};
+			if (count && std::fwrite(sides, sizeof *sides, count, m_file) != count)
+				m_failed = true;
+			if (std::fwrite(&entry, sizeof entry, 1, m_index) != 1)
+				m_failed = true;
+			m_sideCount += count;
+			++m_header.polygonCount;
+		}
+		
+		void addPolygon(const std::vector<std::array<int, 4>>& sides, unsigned int color)
+		{
+			addPolygon(sides.data(), sides.size(), color);
+		}
+		
+		// Appends the index and completes the header. Returns false if anything could not be written.
+		bool close()
+		{
+			if (!m_file)
+				return false;
+			m_header.indexOffset = sizeof m_header + m_sideCount*sizeof(std::array<int, 4>);
+			std::rewind(m_index);
+			char buffer[1 << 16];
+			for (std::size_t read; (read = std::fread(buffer, 1, sizeof buffer, m_index));)
+			{
+				if (std::fwrite(buffer, 1, read, m_file) != read)
+					m_failed = true;
+			}
+			if (std::ferror(m_index) || std::fseek(m_file, 0, SEEK_SET)
+				|| std::fwrite(&m_header, sizeof m_header, 1, m_file) != 1)
+				m_failed = true;
+			std::fclose(m_index), m_index = nullptr;
+			if (std::fclose(m_file))
+				m_failed = true;
+			m_file = nullptr;
+			return !m_failed;
+		}
+};
+
+#endif
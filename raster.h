@@ -0,0 +1,1012 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <GL/glut.h>
+#include <cmath>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <type_traits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+ * The line and ellipse rasterizers shared by the programs in this directory, together with the sinks they draw into.
+ *
+ * A sink is any class with the members below; the rasterizers take it as a template parameter, so every call into it is
+ * resolved at compile time and can be inlined into the rasterizer's inner loop.
+ *
+ *   void begin(), void end()                       bracket a sequence of pixels
+ *   void setColor(unsigned int color)              sets the color of the pixels that follow
+ *   void setPixel(int x, int y)
+ *   void setPixels(const int* xs, const int* ys, int count)
+ *   void setHSpan(int x, int y, int length)        sets (x, y) to (x + `length` - 1, y)
+ *   void setVSpan(int x, int y, int length)        sets (x, y) to (x, y + `length` - 1)
+ *   void fillSpans(const Span* spans, std::size_t count)
+ *                                                  sets the pixels of each span, as filled polygons are produced
+ *   void blendPixels(const int* xs, const int* ys, const unsigned char* coverages, int count)
+ *                                                  blends the color over each pixel by its coverage, 255 being full;
+ *                                                  only needed by the antialiased `lineWu`
+ *
+ * Sinks that only know how to set one pixel derive from `SinkBase`, which supplies the rest in terms of `setPixel`.
+ *
+ * Colors are represented by RGBA values, where each of the four components takes up one (unsigned) byte. These bytes are
+ * packed into an unsigned int, red in the lowest byte, so that a packed color has the same layout in memory as the
+ * `GL_RGBA`/`GL_UNSIGNED_BYTE` pixel format.
+ */
+
+// The pixels from (`xStart`, `y`) up to, but not including, (`xEnd`, `y`).
+struct Span
+{
+	int y;
+	int xStart;
+	int xEnd;
+};
+
+constexpr unsigned int packColor(double r, double g, double b, double a = 1.0)
+{
+	return static_cast<unsigned int>(r*255.0 + 0.5) | static_cast<unsigned int>(g*255.0 + 0.5) << 8
+		| static_cast<unsigned int>(b*255.0 + 0.5) << 16 | static_cast<unsigned int>(a*255.0 + 0.5) << 24;
+}
+
+constexpr int signum(int x)
+{
+	return (x > 0) - (x < 0);
+}
+
+template <typename Derived>
+class SinkBase
+{
+	private:
+		Derived& derived() {return static_cast<Derived&>(*this);}
+		
+	public:
+		void begin() {}
+		void end() {}
+		
+		void setPixels(const int* xs, const int* ys, int count)
+		{
+			for (int i = 0; i < count; ++i)
+				derived().setPixel(xs[i], ys[i]);
+		}
+		
+		void setHSpan(int x, int y, int length)
+		{
+			for (int i = 0; i < length; ++i)
+				derived().setPixel(x + i, y);
+		}
+		
+		void setVSpan(int x, int y, int length)
+		{
+			for (int i = 0; i < length; ++i)
+				derived().setPixel(x, y + i);
+		}
+		
+		void fillSpans(const Span* spans, std::size_t count)
+		{
+			for (std::size_t i = 0; i < count; ++i)
+				derived().setHSpan(spans[i].xStart, spans[i].y, spans[i].xEnd - spans[i].xStart);
+		}
+		
+		// Without blending, a pixel is set if at least half of it is covered.
+		void blendPixels(const int* xs, const int* ys, const unsigned char* coverages, int count)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				if (coverages[i] >= 128)
+					derived().setPixel(xs[i], ys[i]);
+			}
+		}
+};
+
+// Rounds `x` / 255 to the nearest integer, for 0 <= `x` <= 255*255.
+constexpr unsigned int divideBy255(unsigned int x)
+{
+	return (x + 128 + ((x + 128) >> 8)) >> 8;
+}
+
+/*
+ * Draws through the fixed-function pipeline, one `GL_POINTS` vertex per pixel. `blendPixels` scales the alpha of the color
+ * by each pixel's coverage, so `GL_BLEND` has to be enabled, with `GL_SRC_ALPHA`, `GL_ONE_MINUS_SRC_ALPHA`.
+ */
+class GLSink : public SinkBase<GLSink>
+{
+	private:
+		unsigned int m_color = 0xFF000000;
+		
+	public:
+		void begin() {glBegin(GL_POINTS);}
+		
+		void end()
+		{
+			glEnd();
+			glFlush();
+		}
+		
+		void setColor(unsigned int color)
+		{
+			m_color = color;
+			glColor4ub(color, color >> 8, color >> 16, color >> 24);
+		}
+		
+		void setPixel(int x, int y) {glVertex2i(x, y);}
+		
+		void blendPixels(const int* xs, const int* ys, const unsigned char* coverages, int count)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				glColor4ub(m_color, m_color >> 8, m_color >> 16, divideBy255((m_color >> 24) * coverages[i]));
+				glVertex2i(xs[i], ys[i]);
+			}
+			glColor4ub(m_color, m_color >> 8, m_color >> 16, m_color >> 24);
+		}
+};
+
+// A contiguous RGBA8 image in memory. Row 0 is the bottom row, as in the GL window coordinates used by `gluOrtho2D`.
+class Framebuffer
+{
+	private:
+		int m_width;
+		int m_height;
+		unsigned int m_color = 0xFF000000;
+		std::vector<unsigned int> m_pixels;
+		
+		// `alpha`*`m_color` + (255 - `alpha`)*`pixel`, divided by 255 and rounded, in each channel.
+		unsigned int blend(unsigned int pixel, unsigned int alpha) const
+		{
+			unsigned int blended = 0;
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				unsigned int source = m_color >> shift & 0xFF, dest = pixel >> shift & 0xFF;
+				blended |= divideBy255(source*alpha + dest*(255 - alpha)) << shift;
+			}
+			return blended;
+		}
+		
+#ifdef __AVX2__
+		// `blend` for eight pixels at once, with their alphas in 32-bit lanes.
+		__m256i blendEight(__m256i dest, __m256i alpha) const
+		{
+			const __m256i zero = _mm256_setzero_si256(), full = _mm256_set1_epi16(255);
+			const __m256i rounding = _mm256_set1_epi16(128);
+			// Repeating each alpha in both halves of its lane, then unpacking the lanes like the pixels, lines every alpha up
+			// with the four channels of its pixel.
+			alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 16));
+			__m256i source = _mm256_unpacklo_epi8(_mm256_set1_epi32(static_cast<int>(m_color)), zero);
+			auto blend = [&](__m256i dest16, __m256i alpha16)
+			{
+				__m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(source, alpha16),
+					_mm256_mullo_epi16(dest16, _mm256_sub_epi16(full, alpha16)));
+				sum = _mm256_add_epi16(sum, rounding);
+				return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_srli_epi16(sum, 8)), 8);
+			};
+			__m256i low = blend(_mm256_unpacklo_epi8(dest, zero), _mm256_unpacklo_epi32(alpha, alpha));
+			__m256i high = blend(_mm256_unpackhi_epi8(dest, zero), _mm256_unpackhi_epi32(alpha, alpha));
+			return _mm256_packus_epi16(low, high);
+		}
+#endif
+		
+	public:
+		Framebuffer(int width, int height, unsigned int clearColor = 0xFFFFFFFF):
+			m_width(width), m_height(height), m_pixels(static_cast<std::size_t>(width) * height, clearColor) {}
+		
+		int getWidth() const {return m_width;}
+		int getHeight() const {return m_height;}
+		unsigned int* data() {return m_pixels.data();}
+		const unsigned int* data() const {return m_pixels.data();}
+		unsigned int getPixel(int x, int y) const {return m_pixels[static_cast<std::size_t>(y)*m_width + x];}
+		
+		void clear(unsigned int color) {std::fill(m_pixels.begin(), m_pixels.end(), color);}
+		
+		void begin() {}
+		void end() {}
+		void setColor(unsigned int color) {m_color = color;}
+		
+		// Pixels outside the image are discarded, just as GL would clip them.
+		void setPixel(int x, int y)
+		{
+			if (x >= 0 && x < m_width && y >= 0 && y < m_height)
+				m_pixels[static_cast<std::size_t>(y)*m_width + x] = m_color;
+		}
+		
+		void setPixels(const int* xs, const int* ys, int count)
+		{
+			for (int i = 0; i < count; ++i)
+				setPixel(xs[i], ys[i]);
+		}
+		
+		void setHSpan(int x, int y, int length)
+		{
+			int start = std::max(x, 0), stop = std::min(x + length, m_width);
+			if (y >= 0 && y < m_height && start < stop)
+				std::fill_n(&m_pixels[static_cast<std::size_t>(y)*m_width + start], stop - start, m_color);
+		}
+		
+		void setVSpan(int x, int y, int length)
+		{
+			int start = std::max(y, 0), stop = std::min(y + length, m_height);
+			if (x < 0 || x >= m_width || start >= stop)
+				return;
+			for (unsigned int* pixel = &m_pixels[static_cast<std::size_t>(start)*m_width + x]; start < stop; ++start)
+				*pixel = m_color, pixel += m_width;
+		}
+		
+		// With AVX2, eight pixels of a span are stored at a time.
+		void fillSpans(const Span* spans, std::size_t count)
+		{
+#ifdef __AVX2__
+			const __m256i color = _mm256_set1_epi32(static_cast<int>(m_color));
+#endif
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				int start = std::max(spans[i].xStart, 0), stop = std::min(spans[i].xEnd, m_width);
+				if (spans[i].y < 0 || spans[i].y >= m_height || start >= stop)
+					continue;
+				unsigned int* row = &m_pixels[static_cast<std::size_t>(spans[i].y)*m_width];
+				int x = start;
+#ifdef __AVX2__
+				for (; x + 8 <= stop; x += 8)
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + x), color);
+#endif
+				for (; x < stop; ++x)
+					row[x] = m_color;
+			}
+		}
+		
+		/*
+		 * Each pixel becomes `alpha`*color + (255 - `alpha`)*pixel, divided by 255 and rounded, in all four channels, where
+		 * `alpha` is the color's alpha scaled by the pixel's coverage. The pixels given in one call must be distinct. With
+		 * AVX2, eight pixels are gathered, blended in 16-bit lanes and written back at a time; the result is the same.
+		 */
+		void blendPixels(const int* xs, const int* ys, const unsigned char* coverages, int count)
+		{
+			int indices[8], alphas[8];
+			int i = 0;
+			while (i < count)
+			{
+				// Pixels outside the image are dropped while the next group of up to eight is collected.
+				int n = 0;
+				for (; i < count && n < 8; ++i)
+				{
+					if (xs[i] >= 0 && xs[i] < m_width && ys[i] >= 0 && ys[i] < m_height)
+					{
+						indices[n] = ys[i]*m_width + xs[i];
+						alphas[n++] = divideBy255((m_color >> 24) * coverages[i]);
+					}
+				}
+				int j = 0;
+#ifdef __AVX2__
+				if (n == 8)
+				{
+					__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices));
+					__m256i dest = _mm256_i32gather_epi32(reinterpret_cast<const int*>(m_pixels.data()), index, 4);
+					alignas(32) unsigned int blended[8];
+					_mm256_store_si256(reinterpret_cast<__m256i*>(blended),
+						blendEight(dest, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(alphas))));
+					for (; j < 8; ++j)
+						m_pixels[indices[j]] = blended[j];
+				}
+#endif
+				for (; j < n; ++j)
+					m_pixels[indices[j]] = blend(m_pixels[indices[j]], alphas[j]);
+			}
+		}
+		
+		// `blendPixels` for the `count` pixels from (`x`, `y`) to the right, which are contiguous in memory.
+		void blendRow(int x, int y, const unsigned char* coverages, int count)
+		{
+			int start = std::max(x, 0), stop = std::min(x + count, m_width);
+			if (y < 0 || y >= m_height)
+				return;
+			unsigned int* row = &m_pixels[static_cast<std::size_t>(y)*m_width];
+			coverages -= x;
+			int i = start;
+#ifdef __AVX2__
+			const __m256i colorAlpha = _mm256_set1_epi32(static_cast<int>(m_color >> 24));
+			const __m256i rounding = _mm256_set1_epi32(128);
+			for (; i + 8 <= stop; i += 8)
+			{
+				__m256i coverage = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(coverages + i)));
+				// `divideBy255` in 32-bit lanes.
+				__m256i alpha = _mm256_add_epi32(_mm256_mullo_epi32(coverage, colorAlpha), rounding);
+				alpha = _mm256_srli_epi32(_mm256_add_epi32(alpha, _mm256_srli_epi32(alpha, 8)), 8);
+				__m256i* pixels = reinterpret_cast<__m256i*>(row + i);
+				_mm256_storeu_si256(pixels, blendEight(_mm256_loadu_si256(pixels), alpha));
+			}
+#endif
+			for (; i < stop; ++i)
+				row[i] = blend(row[i], divideBy255((m_color >> 24) * coverages[i]));
+		}
+		
+		// Writes a binary (P6) PPM, top row first. Alpha is dropped.
+		bool writePPM(const char* path) const
+		{
+			std::FILE* file = std::fopen(path, "wb");
+			if (!file)
+				return false;
+			std::fprintf(file, "P6\n%d %d\n255\n", m_width, m_height);
+			std::vector<unsigned char> row(3 * static_cast<std::size_t>(m_width));
+			for (int y = m_height - 1; y >= 0; --y)
+			{
+				for (int x = 0; x < m_width; ++x)
+				{
+					unsigned int color = getPixel(x, y);
+					row[3*x] = color, row[3*x + 1] = color >> 8, row[3*x + 2] = color >> 16;
+				}
+				std::fwrite(row.data(), 1, row.size(), file);
+			}
+			return std::fclose(file) == 0;
+		}
+};
+
+// Counts pixels without storing them; used to time rasterizers apart from any memory traffic.
+class CountingSink
+{
+	private:
+		std::size_t m_count = 0;
+		
+	public:
+		std::size_t getCount() const {return m_count;}
+		void reset() {m_count = 0;}
+		
+		void begin() {}
+		void end() {}
+		void setColor(unsigned int) {}
+		void setPixel(int, int) {++m_count;}
+		void setPixels(const int*, const int*, int count) {m_count += count;}
+		void setHSpan(int, int, int length) {m_count += length;}
+		void setVSpan(int, int, int length) {m_count += length;}
+		
+		void fillSpans(const Span* spans, std::size_t count)
+		{
+			for (std::size_t i = 0; i < count; ++i)
+				m_count += spans[i].xEnd - spans[i].xStart;
+		}
+		
+		void blendPixels(const int*, const int*, const unsigned char*, int count) {m_count += count;}
+};
+
+// A horizontal or vertical run of pixels, as recorded by `SpanRecorder`.
+struct LineSpan
+{
+	int x;
+	int y;
+	int length;
+	bool vertical;
+};
+
+// Records everything drawn into it as spans, single pixels becoming spans of length one.
+class SpanRecorder
+{
+	private:
+		std::vector<LineSpan> m_spans;
+		
+	public:
+		const std::vector<LineSpan>& getSpans() const {return m_spans;}
+		void clear() {m_spans.clear();}
+		
+		void begin() {}
+		void end() {}
+		void setColor(unsigned int) {}
+		void setPixel(int x, int y) {m_spans.push_back({x, y, 1, false});}
+		
+		void setPixels(const int* xs, const int* ys, int count)
+		{
+			for (int i = 0; i < count; ++i)
+				setPixel(xs[i], ys[i]);
+		}
+		
+		void setHSpan(int x, int y, int length) {m_spans.push_back({x, y, length, false});}
+		void setVSpan(int x, int y, int length) {m_spans.push_back({x, y, length, true});}
+};
+
+/*
+ * Stores spans compactly, as a byte stream of variable-length integers, three per span: the number of rows since the
+ * previous span, then where the span starts (relative to where the previous one ended, if they share a row), then its
+ * length. Spans are expected in the order `ScanFiller` produces them, bottom row first and left to right, which keeps
+ * every number small; anything else is still encoded correctly, only less compactly.
+ */
+class RunLengthEncoder
+{
+	private:
+		std::vector<unsigned char> m_bytes;
+		int m_y = 0;
+		int m_x = 0;
+		
+		// Zigzag encoding interleaves negative numbers with positive ones, so small magnitudes take one byte.
+		void put(int value)
+		{
+			unsigned int bits = static_cast<unsigned int>(value) << 1 ^ static_cast<unsigned int>(value >> 31);
+			for (; bits >= 0x80; bits >>= 7)
+				m_bytes.push_back(static_cast<unsigned char>(bits | 0x80));
+			m_bytes.push_back(static_cast<unsigned char>(bits));
+		}
+		
+		static int get(const unsigned char*& p)
+		{
+			unsigned int bits = 0;
+			for (int shift = 0; ; shift += 7)
+			{
+				bits |= static_cast<unsigned int>(*p & 0x7F) << shift;
+				if (!(*p++ & 0x80))
+					break;
+			}
+			return static_cast<int>(bits >> 1 ^ -(bits & 1));
+		}
+		
+	public:
+		const std::vector<unsigned char>& getBytes() const {return m_bytes;}
+		
+		void clear()
+		{
+			m_bytes.clear();
+			m_y = m_x = 0;
+		}
+		
+		void fillSpans(const Span* spans, std::size_t count)
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				if (spans[i].y != m_y)
+					m_x = 0;
+				put(spans[i].y - m_y);
+				put(spans[i].xStart - m_x);
+				put(spans[i].xEnd - spans[i].xStart);
+				m_y = spans[i].y, m_x = spans[i].xEnd;
+			}
+		}
+		
+		// Appends the spans encoded so far to `spans`.
+		void decode(std::vector<Span>& spans) const
+		{
+			int y = 0, x = 0;
+			for (const unsigned char *p = m_bytes.data(), *end = p + m_bytes.size(); p != end;)
+			{
+				int deltaY = get(p);
+				if (deltaY)
+					x = 0;
+				y += deltaY;
+				int xStart = x + get(p);
+				x = xStart + get(p);
+				spans.push_back({y, xStart, x});
+			}
+		}
+};
+
+/*
+ * For both the DDA and Bresenham's algorithm, the line function is from `x` to `y` if `deltaX` > `deltaY`, and from `y` to
+ * `x` otherwise. The implementations below take advantage of the fact that neither algorithm requires substantial
+ * modification if the line function is instead defined from `d` to `r`, where `d` is an element of its domain and `r` is an
+ * element of its range, and where the domain and range depend on whether `deltaX` is smaller or larger than `deltaY`.
+ *
+ * Each algorithm is written once, in terms of `d` and `r`, and instantiated for both cases. `Axes<true>` (x-major) and
+ * `Axes<false>` (y-major) turn a domain and range coordinate back into a pixel, so the choice costs nothing per pixel.
+ */
+
+template <typename Sink>
+using lineAlgorithm_t = void(*)(Sink&, int, int, int, int);
+
+template <bool XMajor>
+struct Axes;
+
+template <>
+struct Axes<true>
+{
+	template <typename Sink>
+	static void setPixel(Sink& sink, int d, int r) {sink.setPixel(d, r);}
+
+	template <typename Sink>
+	static void setPixels(Sink& sink, const int* ds, const int* rs, int count) {sink.setPixels(ds, rs, count);}
+
+	// Sets the pixels from `d` to `d` + `length` - 1 at range coordinate `r`.
+	template <typename Sink>
+	static void setRun(Sink& sink, int d, int r, int length) {sink.setHSpan(d, r, length);}
+
+	template <typename Sink>
+	static void blendPixels(Sink& sink, const int* ds, const int* rs, const unsigned char* coverages, int count)
+	{
+		sink.blendPixels(ds, rs, coverages, count);
+	}
+};
+
+template <>
+struct Axes<false>
+{
+	template <typename Sink>
+	static void setPixel(Sink& sink, int d, int r) {sink.setPixel(r, d);}
+
+	template <typename Sink>
+	static void setPixels(Sink& sink, const int* ds, const int* rs, int count) {sink.setPixels(rs, ds, count);}
+
+	template <typename Sink>
+	static void setRun(Sink& sink, int d, int r, int length) {sink.setVSpan(r, d, length);}
+
+	template <typename Sink>
+	static void blendPixels(Sink& sink, const int* ds, const int* rs, const unsigned char* coverages, int count)
+	{
+		sink.blendPixels(rs, ds, coverages, count);
+	}
+};
+
+// The domain and range variables of a line, their deltas, and the sign of each step.
+struct LineSetup
+{
+	int domainVar, rangeVar;
+	int domainDelta, rangeDelta;
+	int domainStep, rangeStep;
+};
+
+template <bool XMajor>
+LineSetup setUpLine(int x1, int y1, int x2, int y2)
+{
+	if (XMajor)
+		return {x1, y1, std::abs(x2 - x1), std::abs(y2 - y1), signum(x2 - x1), signum(y2 - y1)};
+	return {y1, x1, std::abs(y2 - y1), std::abs(x2 - x1), signum(y2 - y1), signum(x2 - x1)};
+}
+
+template <bool XMajor, typename Sink>
+void bresenhamSteps(Sink& sink, LineSetup line)
+{
+	int p = 2*line.rangeDelta - line.domainDelta;
+	// `d_lower` and `d_upper` are special cases of `d_same` and `d_changed` for when slope is positive.
+	int same = 2*line.rangeDelta;
+	int changed = same - 2*line.domainDelta;
+	for (int i = 0; i < line.domainDelta; ++i)
+	{
+		Axes<XMajor>::setPixel(sink, line.domainVar, line.rangeVar);
+		line.domainVar += line.domainStep;
+		if (p < 0)
+			p += same;
+		else
+		{
+			p += changed;
+			line.rangeVar += line.rangeStep;
+		}
+	}
+}
+
+template <typename Sink>
+void lineBresenham(Sink& sink, int x1, int y1, int x2, int y2)
+{
+	if (std::abs(x2 - x1) > std::abs(y2 - y1))
+		bresenhamSteps<true>(sink, setUpLine<true>(x1, y1, x2, y2));
+	else
+		bresenhamSteps<false>(sink, setUpLine<false>(x1, y1, x2, y2));
+}
+
+/*
+ * Produces the same pixels as `lineBresenham`, but a run at a time: a run is a maximal sequence of pixels that share a
+ * range coordinate, and becomes one horizontal span for x-major lines and one vertical span otherwise. The length of each
+ * run is worked out from the decision variable instead of being discovered one step at a time. Every run but the first and
+ * last has a length of either `baseRun` = `domainDelta` / `rangeDelta` or `baseRun` + 1. Adding `baseRun` - 1 steps' worth
+ * of `same` to `p` at once leaves a single comparison to tell the two apart.
+ */
+template <bool XMajor, typename Sink>
+void bresenhamRuns(Sink& sink, LineSetup line)
+{
+	// Runs are stepped in the direction of the line, but spans always start at their lowest coordinate.
+	auto emit = [&](int length)
+	{
+		int start = line.domainStep < 0 ? line.domainVar - length + 1 : line.domainVar;
+		Axes<XMajor>::setRun(sink, start, line.rangeVar, length);
+	};
+	if (!line.domainDelta)
+		return;
+	if (!line.rangeDelta)
+		return emit(line.domainDelta);
+	int same = 2*line.rangeDelta;
+	int changed = same - 2*line.domainDelta;
+	int p = same - line.domainDelta;
+	int remaining = line.domainDelta;
+	// The first run is one pixel longer than the number of steps it takes `p` to stop being negative.
+	int length = 1;
+	if (p < 0)
+	{
+		int steps = (same - 1 - p) / same;
+		length += steps, p += steps*same;
+	}
+	int baseRun = line.domainDelta / line.rangeDelta;
+	while (length < remaining)
+	{
+		emit(length);
+		line.domainVar += line.domainStep*length, line.rangeVar += line.rangeStep;
+		remaining -= length;
+		p += changed + (baseRun - 1)*same;
+		length = baseRun;
+		if (p < 0)
+			p += same, ++length;
+	}
+	emit(remaining);
+}
+
+template <typename Sink>
+void lineBresenhamRuns(Sink& sink, int x1, int y1, int x2, int y2)
+{
+	if (std::abs(x2 - x1) > std::abs(y2 - y1))
+		bresenhamRuns<true>(sink, setUpLine<true>(x1, y1, x2, y2));
+	else
+		bresenhamRuns<false>(sink, setUpLine<false>(x1, y1, x2, y2));
+}
+
+/*
+ * The DDA in fixed point with `FracBits` fractional bits. The range variable is kept as an offset from its starting value,
+ * in `acc`, which starts at one half so that truncating it rounds to the nearest pixel. The loop runs for exactly
+ * `domainDelta` steps and adds nothing but integers.
+ *
+ * Bresenham's algorithm puts the range variable at floor(k*`rangeDelta`/`domainDelta` + 1/2) after k steps. The slope is
+ * rounded up rather than down, so `acc` never falls behind that value, and it gains less than one unit in the last place
+ * per step. Since the exact value is a multiple of 1/(2*`domainDelta`), the two algorithms produce identical pixels
+ * whenever 2*`domainDelta`^2 <= 2^`FracBits`: for lines of up to 181 pixels in 16.16, and 46340 pixels in 32.32.
+ *
+ * A 32-bit `fixed_t` holds range offsets below 2^(31 - `FracBits`), so lines that cross 2^(30 - `FracBits`) rows or
+ * columns or more are stepped in 64 bits instead. With AVX2 and a 32-bit `fixed_t`, eight consecutive pixels are computed
+ * per iteration.
+ */
+template <int FracBits, bool XMajor, typename fixed_t, typename Sink>
+void ddaSteps(Sink& sink, LineSetup line)
+{
+	if (!line.domainDelta)
+		return;
+	std::int64_t scaledDelta = static_cast<std::int64_t>(line.rangeDelta) << FracBits;
+	fixed_t slope = static_cast<fixed_t>((scaledDelta + line.domainDelta - 1) / line.domainDelta);
+	fixed_t acc = static_cast<fixed_t>(1) << (FracBits - 1);
+	int i = 0;
+#ifdef __AVX2__
+	if (sizeof(fixed_t) == sizeof(std::int32_t))
+	{
+		constexpr int k_lanes = 8;
+		alignas(32) int domainCoords[k_lanes], rangeCoords[k_lanes];
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256i rangeBase = _mm256_set1_epi32(line.rangeVar), rangeSign = _mm256_set1_epi32(line.rangeStep);
+		const __m256i accStep = _mm256_set1_epi32(static_cast<int>(k_lanes*slope));
+		const __m256i domainIncrement = _mm256_set1_epi32(k_lanes*line.domainStep);
+		__m256i accs = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(acc)),
+			_mm256_mullo_epi32(lanes, _mm256_set1_epi32(static_cast<int>(slope))));
+		__m256i domainVars = _mm256_add_epi32(_mm256_set1_epi32(line.domainVar),
+			_mm256_mullo_epi32(lanes, _mm256_set1_epi32(line.domainStep)));
+		for (; i + k_lanes <= line.domainDelta; i += k_lanes)
+		{
+			__m256i rangeVars = _mm256_add_epi32(rangeBase, _mm256_sign_epi32(_mm256_srai_epi32(accs, FracBits), rangeSign));
+			_mm256_store_si256(reinterpret_cast<__m256i*>(domainCoords), domainVars);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(rangeCoords), rangeVars);
+			Axes<XMajor>::setPixels(sink, domainCoords, rangeCoords, k_lanes);
+			accs = _mm256_add_epi32(accs, accStep);
+			domainVars = _mm256_add_epi32(domainVars, domainIncrement);
+		}
+		acc += i*slope, line.domainVar += i*line.domainStep;
+	}
+#endif
+	for (; i < line.domainDelta; ++i)
+	{
+		Axes<XMajor>::setPixel(sink, line.domainVar, line.rangeVar + line.rangeStep*static_cast<int>(acc >> FracBits));
+		line.domainVar += line.domainStep, acc += slope;
+	}
+}
+
+// Steps `line` with a 32-bit `fixed_t` if its range offsets fit in one, and with a 64-bit one if not.
+template <int FracBits, bool XMajor, typename Sink>
+void ddaLine(Sink& sink, LineSetup line)
+{
+	constexpr bool k_narrow = FracBits <= 16;
+	using narrow_t = typename std::conditional<k_narrow, std::int32_t, std::int64_t>::type;
+	if (k_narrow && line.rangeDelta < (1 << (k_narrow ? 30 - FracBits : 0)))
+		ddaSteps<FracBits, XMajor, narrow_t>(sink, line);
+	else
+		ddaSteps<FracBits, XMajor, std::int64_t>(sink, line);
+}
+
+template <int FracBits, typename Sink>
+void lineDDAFixed(Sink& sink, int x1, int y1, int x2, int y2)
+{
+	if (std::abs(x2 - x1) > std::abs(y2 - y1))
+		ddaLine<FracBits, true>(sink, setUpLine<true>(x1, y1, x2, y2));
+	else
+		ddaLine<FracBits, false>(sink, setUpLine<false>(x1, y1, x2, y2));
+}
+
+template <typename Sink>
+void lineDDA(Sink& sink, int x1, int y1, int x2, int y2)
+{
+	lineDDAFixed<16>(sink, x1, y1, x2, y2);
+}
+
+/*
+ * Xiaolin Wu's antialiased line, in integers. As in the fixed-point DDA, the exact range offset k*`rangeDelta`/`domainDelta`
+ * is kept in `acc`, with 32 fractional bits, but here it starts at zero and is not rounded: the line passes between the
+ * pixel at its integer part and the next pixel over, and the top eight bits of its fraction are the coverage of that next
+ * pixel. The two coverages of each step add up to 255. The pixels are the same `domainDelta` steps that `lineBresenham`
+ * takes, and they are handed to `Sink::blendPixels` in batches. The slope is rounded down, so `acc` falls behind by less
+ * than 2^-32 of a pixel per step: a line a million pixels long ends less than 1/4000 of a pixel short.
+ */
+template <bool XMajor, typename Sink>
+void wuSteps(Sink& sink, LineSetup line)
+{
+	constexpr int k_batch = 128;
+	int domainCoords[k_batch], rangeCoords[k_batch];
+	unsigned char coverages[k_batch];
+	if (!line.domainDelta)
+		return;
+	std::uint64_t slope = (static_cast<std::uint64_t>(line.rangeDelta) << 32) / line.domainDelta;
+	std::uint64_t acc = 0;
+	int count = 0;
+	for (int i = 0; i < line.domainDelta; ++i)
+	{
+		int rangeVar = line.rangeVar + line.rangeStep*static_cast<int>(acc >> 32);
+		unsigned int far = static_cast<unsigned int>(acc >> 24 & 0xFF);
+		domainCoords[count] = line.domainVar, rangeCoords[count] = rangeVar, coverages[count++] = 255 - far;
+		// Leaving out uncovered pixels also keeps the pixels of a horizontal or vertical line distinct.
+		if (far)
+			domainCoords[count] = line.domainVar, rangeCoords[count] = rangeVar + line.rangeStep, coverages[count++] = far;
+		if (count > k_batch - 2)
+		{
+			Axes<XMajor>::blendPixels(sink, domainCoords, rangeCoords, coverages, count);
+			count = 0;
+		}
+		line.domainVar += line.domainStep, acc += slope;
+	}
+	Axes<XMajor>::blendPixels(sink, domainCoords, rangeCoords, coverages, count);
+}
+
+template <typename Sink>
+void lineWu(Sink& sink, int x1, int y1, int x2, int y2)
+{
+	if (std::abs(x2 - x1) > std::abs(y2 - y1))
+		wuSteps<true>(sink, setUpLine<true>(x1, y1, x2, y2));
+	else
+		wuSteps<false>(sink, setUpLine<false>(x1, y1, x2, y2));
+}
+
+/*
+ * Segments in structure-of-arrays layout: segment `i` runs from (`x1[i]`, `y1[i]`) to (`x2[i]`, `y2[i]`). A
+ * `SegmentBuffer` is the writable counterpart that clipped segments are stored in.
+ */
+struct SegmentSpan
+{
+	const int* x1;
+	const int* y1;
+	const int* x2;
+	const int* y2;
+	std::size_t count;
+};
+
+struct SegmentBuffer
+{
+	int* x1;
+	int* y1;
+	int* x2;
+	int* y2;
+};
+
+/*
+ * Rasterizes every segment in `segments`, producing exactly the pixels that `lineBresenham` produces for each of them,
+ * though not in the same order. When compiled with AVX2, eight segments are stepped together, one per lane. Every lane
+ * carries its own decision variable, and the branch in `lineBresenham` becomes a per-lane select between the steps taken
+ * when the range variable stays the same and when it changes. A group of eight runs for as long as its longest segment;
+ * lanes whose segments have ended are masked off. Leftover segments, and every segment on other targets, go through
+ * `lineBresenham`.
+ */
+template <typename Sink>
+void lineBresenhamBatch(Sink& sink, const SegmentSpan& segments)
+{
+	std::size_t i = 0;
+#ifdef __AVX2__
+	constexpr int k_lanes = 8;
+	const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi32(1);
+	alignas(32) int xs[k_lanes], ys[k_lanes], lengths[k_lanes];
+	int activeXs[k_lanes], activeYs[k_lanes];
+	for (; i + k_lanes <= segments.count; i += k_lanes)
+	{
+		auto load = [i](const int* p){return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));};
+		__m256i x = load(segments.x1), y = load(segments.y1);
+		__m256i signedDeltaX = _mm256_sub_epi32(load(segments.x2), x);
+		__m256i signedDeltaY = _mm256_sub_epi32(load(segments.y2), y);
+		__m256i deltaX = _mm256_abs_epi32(signedDeltaX), deltaY = _mm256_abs_epi32(signedDeltaY);
+		__m256i stepX = _mm256_sign_epi32(one, signedDeltaX), stepY = _mm256_sign_epi32(one, signedDeltaY);
+		// All ones in the lanes where `x` is the domain variable.
+		__m256i xMajor = _mm256_cmpgt_epi32(deltaX, deltaY);
+		__m256i domainDelta = _mm256_blendv_epi8(deltaY, deltaX, xMajor);
+		__m256i rangeDelta = _mm256_blendv_epi8(deltaX, deltaY, xMajor);
+		// Each coordinate takes its domain step every iteration, and its range step only when the range variable changes.
+		__m256i xDomainStep = _mm256_and_si256(xMajor, stepX), xRangeStep = _mm256_andnot_si256(xMajor, stepX);
+		__m256i yDomainStep = _mm256_andnot_si256(xMajor, stepY), yRangeStep = _mm256_and_si256(xMajor, stepY);
+		__m256i same = _mm256_add_epi32(rangeDelta, rangeDelta);
+		__m256i changed = _mm256_sub_epi32(same, _mm256_add_epi32(domainDelta, domainDelta));
+		__m256i p = _mm256_sub_epi32(same, domainDelta);
+		__m256i remaining = domainDelta;
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lengths), domainDelta);
+		int maxLength = *std::max_element(lengths, lengths + k_lanes);
+		for (int step = 0; step < maxLength; ++step)
+		{
+			_mm256_store_si256(reinterpret_cast<__m256i*>(xs), x);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(ys), y);
+			int active = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(remaining, zero)));
+			if (active == (1 << k_lanes) - 1)
+				sink.setPixels(xs, ys, k_lanes);
+			else
+			{
+				int count = 0;
+				for (int lane = 0; lane < k_lanes; ++lane)
+				{
+					if (active >> lane & 1)
+						activeXs[count] = xs[lane], activeYs[count] = ys[lane], ++count;
+				}
+				sink.setPixels(activeXs, activeYs, count);
+			}
+			// All ones in the lanes where `p` < 0, i.e. where the range variable stays the same.
+			__m256i keep = _mm256_cmpgt_epi32(zero, p);
+			p = _mm256_add_epi32(p, _mm256_blendv_epi8(changed, same, keep));
+			x = _mm256_add_epi32(x, _mm256_add_epi32(xDomainStep, _mm256_andnot_si256(keep, xRangeStep)));
+			y = _mm256_add_epi32(y, _mm256_add_epi32(yDomainStep, _mm256_andnot_si256(keep, yRangeStep)));
+			remaining = _mm256_sub_epi32(remaining, one);
+		}
+	}
+#endif
+	for (; i < segments.count; ++i)
+		lineBresenham(sink, segments.x1[i], segments.y1[i], segments.x2[i], segments.y2[i]);
+}
+
+/*
+ * The rows of the midpoint ellipse centred on the origin with radii `radiusX` and `radiusY`, from the top row down to
+ * row 0, with the extent of the outline on each. These are the points of the first quadrant that `drawEllipse` plots,
+ * found with the same decision variables: on every row they form one run, from (`xMin`, `y`) to (`xMax`, `y`), and the
+ * three other quadrants are its mirror images.
+ */
+class EllipseRows
+{
+	private:
+		int m_rxSquared;
+		int m_rySquared;
+		int m_x = 0;
+		int m_y;
+		int m_p;
+		bool m_secondRegion = false;
+		
+		// The second region, in which the curve is steeper than 45 degrees, starts from the point after the first.
+		void enterSecondRegionIfDue()
+		{
+			if (!m_secondRegion && 2*m_rySquared*m_x > 2*m_rxSquared*m_y)
+			{
+				m_secondRegion = true;
+				m_p = static_cast<int>(std::round(m_rySquared*(m_x*m_x + m_x + 0.25)
+					+ m_rxSquared*(m_y*m_y - 2*m_y + 1) - static_cast<double>(m_rxSquared)*m_rySquared));
+			}
+		}
+		
+		void step()
+		{
+			if (!m_secondRegion)
+			{
+				m_p += 2*m_rySquared*++m_x + m_rySquared;
+				if (m_p >= 0)
+					m_p -= 2*m_rxSquared*--m_y;
+				enterSecondRegionIfDue();
+			}
+			else
+			{
+				m_p += m_rxSquared - 2*m_rxSquared*--m_y;
+				if (m_p <= 0)
+					m_p += 2*m_rySquared*++m_x;
+			}
+		}
+		
+	public:
+		EllipseRows(int radiusX, int radiusY):
+			m_rxSquared(radiusX*radiusX), m_rySquared(radiusY*radiusY), m_y(radiusY),
+			m_p(static_cast<int>(std::round(m_rySquared - m_rxSquared*radiusY + 0.25*m_rxSquared)))
+		{
+			enterSecondRegionIfDue();
+		}
+		
+		// Moves on to the next row down, returning false once row 0 has been passed.
+		bool next(int& y, int& xMin, int& xMax)
+		{
+			if (m_y < 0)
+				return false;
+			y = m_y, xMin = m_x;
+			do
+			{
+				xMax = m_x;
+				step();
+			}
+			while (m_y == y);
+			return true;
+		}
+};
+
+/*
+ * Fills an ellipse, or the ring between two, with spans computed straight from the midpoint decision variables, so the
+ * inside of a shape is known without drawing its outline and searching for what it encloses. Spans are handed to
+ * `Sink::fillSpans` a batch at a time.
+ *
+ * The ring between an outer ellipse with radii `outerX`, `outerY` and an inner one with radii `innerX`, `innerY` holds
+ * every pixel of the outer outline, of the inner outline, and between the two. The inner ellipse must lie within the
+ * outer one. Passing the same radii for both gives the outline alone, the pixels `drawEllipse` plots.
+ */
+template <typename Sink>
+void fillAnnulus(Sink& sink, int centerX, int centerY, int outerX, int outerY, int innerX, int innerY)
+{
+	constexpr int k_batch = 128;
+	Span spans[k_batch];
+	int count = 0;
+	auto add = [&](int y, int xStart, int xEnd)
+	{
+		if (xStart >= xEnd)
+			return;
+		spans[count++] = {y, xStart, xEnd};
+		if (count == k_batch)
+		{
+			sink.fillSpans(spans, count);
+			count = 0;
+		}
+	};
+	EllipseRows outer(outerX, outerY);
+	// A negative inner radius leaves out the inner ellipse, so that the whole of the outer one is filled.
+	EllipseRows inner(std::max(innerX, 0), innerY);
+	int y, outerMin, outerMax, innerRow = innerY + 1, innerMin, innerMax;
+	while (outer.next(y, outerMin, outerMax))
+	{
+		// Both ellipses are walked from the top down, and the inner one starts once the outer one is level with it.
+		int hole = 0;
+		if (y < innerRow && inner.next(innerRow, innerMin, innerMax))
+			hole = innerMin;
+		for (int row: {centerY + y, centerY - y})
+		{
+			if (hole > 0)
+			{
+				add(row, centerX - outerMax, centerX - hole + 1);
+				add(row, centerX + hole, centerX + outerMax + 1);
+			}
+			else
+				add(row, centerX - outerMax, centerX + outerMax + 1);
+			if (!y)
+				break;
+		}
+	}
+	if (count)
+		sink.fillSpans(spans, count);
+}
+
+// Fills an ellipse together with its outline.
+template <typename Sink>
+void fillEllipse(Sink& sink, int centerX, int centerY, int radiusX, int radiusY)
+{
+	fillAnnulus(sink, centerX, centerY, radiusX, radiusY, -1, -1);
+}
+
+/*
+ * Fills the inside of an ellipse, leaving out its outline: the pixels that a 4-connected flood fill from the centre would
+ * reach once the outline had been drawn.
+ */
+template <typename Sink>
+void fillEllipseInterior(Sink& sink, int centerX, int centerY, int radiusX, int radiusY)
+{
+	constexpr int k_batch = 128;
+	Span spans[k_batch];
+	int count = 0;
+	EllipseRows rows(radiusX, radiusY);
+	int y, xMin, xMax;
+	while (rows.next(y, xMin, xMax))
+	{
+		if (xMin < 1)
+			continue;
+		spans[count++] = {centerY + y, centerX - xMin + 1, centerX + xMin};
+		if (y)
+			spans[count++] = {centerY - y, centerX - xMin + 1, centerX + xMin};
+		if (count > k_batch - 2)
+		{
+			sink.fillSpans(spans, count);
+			count = 0;
+		}
+	}
+	if (count)
+		sink.fillSpans(spans, count);
+}
+
+#endif
@@ -1,7 +1,15 @@
-#include <windows.h>
-#include <GL/glut.h>
+#include "raster.h"
+#include "thread_pool.h"
 #include <functional>
 #include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 /*
  * Colors are represented by RGBA values, where each of the four components takes up one (unsigned) byte. These bytes are
@@ -17,62 +25,575 @@ constexpr int k_ringCenterOffsets[5][2]{{50, 200}, {150, 200}, {250, 200}, {100,
 constexpr unsigned int k_ringBoundaryColors[5]{0xFFFF0000, 0xFF000000, 0xFF0000FF, 0xFF00FFFF, 0xFF00FF00};
 constexpr unsigned int k_ringFillColors[5]{0xFF000000, 0xFF0000FF, 0xFF00FFFF, 0xFF00FF00, 0xFFFF0000};
 
-void setPixel(int x, int y, unsigned int color)
+// The pixels from (`xMin`, `yMin`) up to, but not including, (`xMax`, `yMax`).
+struct Rect
 {
-	glBegin(GL_POINTS);
-	glColor4ub(color, color >> 8, color >> 16, color >> 24);
-	glVertex2i(x, y);
-	glEnd();
+	int xMin;
+	int yMin;
+	int xMax;
+	int yMax;
+	
+	bool isEmpty() const {return xMin >= xMax || yMin >= yMax;}
+};
+
+// An RGBA8 copy of the window in memory, so that fills can read and write pixels without a round trip to GL for each.
+class Image
+{
+	private:
+		int m_width;
+		int m_height;
+		std::vector<unsigned int> m_pixels;
+		
+	public:
+		Image(int width, int height):
+			m_width(width), m_height(height), m_pixels(static_cast<std::size_t>(width)*height) {}
+		
+		int getWidth() const {return m_width;}
+		int getHeight() const {return m_height;}
+		unsigned int* getRow(int y) {return &m_pixels[static_cast<std::size_t>(y)*m_width];}
+		const unsigned int* getRow(int y) const {return &m_pixels[static_cast<std::size_t>(y)*m_width];}
+		
+		// Copies the window into the image with one `glReadPixels`.
+		void read()
+		{
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, m_pixels.data());
+		}
+		
+		// Copies the pixels of `rect` back to the same place in the window with one `glDrawPixels`.
+		void draw(const Rect& rect) const
+		{
+			if (rect.isEmpty())
+				return;
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, m_width);
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.xMin);
+			glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.yMin);
+			glRasterPos2i(k_xMin + rect.xMin, k_yMin + rect.yMin);
+			glDrawPixels(rect.xMax - rect.xMin, rect.yMax - rect.yMin, GL_RGBA, GL_UNSIGNED_BYTE, m_pixels.data());
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+			glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+		}
+};
+
+enum class Connectivity
+{
+	// Pixels are joined to the pixels beside, above and below them.
+	four,
+	// Pixels are joined diagonally as well.
+	eight
+};
+
+/*
+ * The predicates of flood fill and boundary fill, and of a flood fill that tolerates small differences of color, as
+ * function objects. Unlike a lambda, each has a type of its own, by which `VectorPredicate` recognizes it.
+ */
+
+// The pixel is not `param`, the color of the boundary, and has not been filled yet.
+struct InsideBoundary
+{
+	unsigned int fillColor;
+	
+	bool operator()(unsigned int param, unsigned int pixelColor) const
+	{
+		return pixelColor != param && pixelColor != fillColor;
+	}
+};
+
+// Each channel of the pixel is within the matching channel of `tolerances` of the same channel of `param`.
+struct WithinTolerance
+{
+	unsigned int tolerances;
+	
+	bool operator()(unsigned int param, unsigned int pixelColor) const
+	{
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			int difference = static_cast<int>(pixelColor >> shift & 0xFF) - static_cast<int>(param >> shift & 0xFF);
+			if (std::abs(difference) > static_cast<int>(tolerances >> shift & 0xFF))
+				return false;
+		}
+		return true;
+	}
+};
+
+#ifdef __AVX2__
+/*
+ * The form of a predicate that tests eight pixels at once, for the predicates that have one. `test` returns all ones in
+ * the lanes of `pixels` for which `pred(param, pixelColor)` holds and zeros elsewhere, with `param` in every lane. Any
+ * other predicate is tested one pixel at a time.
+ */
+template <typename BinaryColorPredicate>
+struct VectorPredicate
+{
+	static constexpr bool k_exists = false;
+	
+	// Only here so that callers compile; they test `k_exists` first.
+	static __m256i test(const BinaryColorPredicate&, __m256i, __m256i) {return _mm256_setzero_si256();}
+};
+
+template <>
+struct VectorPredicate<std::equal_to<unsigned int>>
+{
+	static constexpr bool k_exists = true;
+	
+	static __m256i test(const std::equal_to<unsigned int>&, __m256i param, __m256i pixels)
+	{
+		return _mm256_cmpeq_epi32(pixels, param);
+	}
+};
+
+template <>
+struct VectorPredicate<InsideBoundary>
+{
+	static constexpr bool k_exists = true;
+	
+	static __m256i test(const InsideBoundary& pred, __m256i param, __m256i pixels)
+	{
+		__m256i outside = _mm256_or_si256(_mm256_cmpeq_epi32(pixels, param),
+			_mm256_cmpeq_epi32(pixels, _mm256_set1_epi32(static_cast<int>(pred.fillColor))));
+		return _mm256_xor_si256(outside, _mm256_set1_epi32(-1));
+	}
+};
+
+template <>
+struct VectorPredicate<WithinTolerance>
+{
+	static constexpr bool k_exists = true;
+	
+	static __m256i test(const WithinTolerance& pred, __m256i param, __m256i pixels)
+	{
+		// The absolute difference of unsigned bytes is the larger of the two saturated differences, and it is within
+		// the tolerance exactly when taking the tolerance away from it saturates to zero.
+		__m256i difference = _mm256_or_si256(_mm256_subs_epu8(pixels, param), _mm256_subs_epu8(param, pixels));
+		__m256i excess = _mm256_subs_epu8(difference, _mm256_set1_epi32(static_cast<int>(pred.tolerances)));
+		return _mm256_cmpeq_epi32(excess, _mm256_setzero_si256());
+	}
+};
+
+// The lanes of a test, one bit each, with the bits of lanes that disagree with `value` set.
+template <bool value, typename BinaryColorPredicate>
+unsigned int findMismatches(const BinaryColorPredicate& pred, __m256i param, const unsigned int* pixels)
+{
+	__m256i matches = VectorPredicate<BinaryColorPredicate>::test(pred, param,
+		_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels)));
+	unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(matches)));
+	return value ? ~mask & 0xFF : mask;
 }
 
+int lowestBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+int highestBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, mask);
+	return static_cast<int>(index);
+#else
+	return 31 - __builtin_clz(mask);
+#endif
+}
+#endif
+
 /*
- * Fills the region surrounding the point (x, y) with a given color while a condition (of the type described below) is true,
- * via a template for the family of algorithms that includes flood fill and boundary fill, specifically their 4-connected
- * variants. It is guaranteed to work properly for any convex region.
+ * The first pixel of `row` from `x` up to `end` - 1 for which `pred(param, pixelColor)` is not `value`, or `end` if
+ * there is none. With AVX2, predicates that have a `VectorPredicate` are tested eight pixels at a time.
+ */
+template <bool value, typename BinaryColorPredicate>
+int scanRight(const BinaryColorPredicate& pred, unsigned int param, const unsigned int* row, int x, int end)
+{
+#ifdef __AVX2__
+	if (VectorPredicate<BinaryColorPredicate>::k_exists)
+	{
+		const __m256i params = _mm256_set1_epi32(static_cast<int>(param));
+		for (; x + 8 <= end; x += 8)
+		{
+			if (unsigned int mismatches = findMismatches<value>(pred, params, row + x))
+				return x + lowestBit(mismatches);
+		}
+	}
+#endif
+	for (; x < end && pred(param, row[x]) == value; ++x);
+	return x;
+}
+
+// As `scanRight`, but from `x` down to `begin`, returning `begin` - 1 if every pixel matches.
+template <bool value, typename BinaryColorPredicate>
+int scanLeft(const BinaryColorPredicate& pred, unsigned int param, const unsigned int* row, int x, int begin)
+{
+#ifdef __AVX2__
+	if (VectorPredicate<BinaryColorPredicate>::k_exists)
+	{
+		const __m256i params = _mm256_set1_epi32(static_cast<int>(param));
+		for (; x - 7 >= begin; x -= 8)
+		{
+			if (unsigned int mismatches = findMismatches<value>(pred, params, row + x - 7))
+				return x - 7 + highestBit(mismatches);
+		}
+	}
+#endif
+	for (; x >= begin && pred(param, row[x]) == value; --x);
+	return x;
+}
+
+/*
+ * Fills the region of `image` around the pixel (x, y) with a given color while a condition (of the type described
+ * below) is true, via a template for the family of algorithms that includes flood fill and boundary fill. The region
+ * can have any shape, and is 4-connected or 8-connected as asked. Returns the smallest rectangle holding every pixel
+ * that was set.
+ *
+ * A `BinaryColorPredicate` takes arguments `param` and `pixelColor`, where `pixelColor` is the color of the next pixel
+ * to be set, and `param` is a color passed to `fillWhile` that serves as a parameter (in the mathematical sense) that
+ * is bound to the predicate. It must be false for `fillColor`, since that is how set pixels are told apart from those
+ * still to be filled; if it is not, nothing is filled.
  *
- * A `BinaryColorPredicate` takes arguments `pixelColor` and `param`, where `pixelColor` is the color of the next pixel to
- * be set, and `param` is a color passed to `fillWhile` that serves as a parameter (in the mathematical sense) that is bound
- * to the predicate.
+ * This is Heckbert's seed fill. Each entry on an explicit stack is a run of pixels that was filled on one row, with the
+ * direction of the next row to search from it. Filling a run extends it left and right as far as the predicate allows,
+ * and only the parts of the next row that stick out past the run that led to it are searched back in the other
+ * direction, so no run is scanned twice and the stack grows with the complexity of the region rather than its size.
+ * Under 8-connectivity, the next row is searched from one pixel before a run to one pixel after it, to take in its
+ * diagonals.
  */
 template <typename BinaryColorPredicate>
-void fillWhile(int x, int y, unsigned int fillColor, const BinaryColorPredicate& pred, unsigned int param)
+Rect fillWhile(Image& image, int x, int y, unsigned int fillColor, const BinaryColorPredicate& pred, unsigned int param,
+	Connectivity connectivity = Connectivity::four)
 {
-	unsigned int pixelColor;
-	glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixelColor);
-	if (pred(param, pixelColor))
+	Rect filled{x, y, x, y};
+	int width = image.getWidth(), height = image.getHeight();
+	if (x < 0 || x >= width || y < 0 || y >= height || pred(param, fillColor) || !pred(param, image.getRow(y)[x]))
+		return filled;
+	// The run from `left` to `right` was filled on row `y`, and row `y` + `deltaY` is to be searched next.
+	struct Run
+	{
+		int y;
+		int left;
+		int right;
+		int deltaY;
+	};
+	std::vector<Run> stack;
+	auto push = [&](int y, int left, int right, int deltaY)
+	{
+		if (y + deltaY >= 0 && y + deltaY < height)
+			stack.push_back({y, left, right, deltaY});
+	};
+	int reach = connectivity == Connectivity::eight;
+	// The seed is treated as a run of one pixel found on the rows above and below it, which sends the search to its own
+	// row from both sides.
+	push(y, x, x, 1);
+	push(y + 1, x, x, -1);
+	filled = {width, height, 0, 0};
+	while (!stack.empty())
 	{
-		setPixel(x, y, fillColor);
-		glReadPixels(x+1, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixelColor);
-		int rightOffset = 0;
-		while (pred(param, pixelColor))
+		Run run = stack.back();
+		stack.pop_back();
+		int deltaY = run.deltaY;
+		int searchLeft = std::max(run.left - reach, 0), searchRight = std::min(run.right + reach, width - 1);
+		int left;
+		unsigned int* row = image.getRow(y = run.y + deltaY);
+		// The part of the new run left of where the search starts.
+		x = scanLeft<true>(pred, param, row, searchLeft, 0);
+		if (x < searchLeft)
 		{
-			setPixel(x + ++rightOffset, y, fillColor);
-			glReadPixels(x + rightOffset + 1, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixelColor);
+			left = x + 1;
+			if (left < run.left)
+				push(y, left, run.left - 1, -deltaY);
+			x = searchLeft + 1;
 		}
-		glReadPixels(x-1, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixelColor);
-		int leftOffset = 0;
-		while (pred(param, pixelColor))
+		else
 		{
-			setPixel(x - ++leftOffset, y, fillColor);
-			glReadPixels(x - leftOffset - 1, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixelColor);
+			// The pixel where the search starts is not part of the region, so the first new run, if any, starts further
+			// right.
+			left = x = scanRight<false>(pred, param, row, x + 1, searchRight + 1);
+		}
+		while (left <= searchRight)
+		{
+			x = scanRight<true>(pred, param, row, x, width);
+			std::fill(row + left, row + x, fillColor);
+			filled.xMin = std::min(filled.xMin, left), filled.xMax = std::max(filled.xMax, x);
+			filled.yMin = std::min(filled.yMin, y), filled.yMax = std::max(filled.yMax, y + 1);
+			push(y, left, x - 1, deltaY);
+			if (x > run.right + 1)
+				push(y, run.right + 1, x - 1, -deltaY);
+			left = x = scanRight<false>(pred, param, row, x + 1, searchRight + 1);
 		}
-		fillWhile(x, y+1, fillColor, pred, param);
-		fillWhile(x, y-1, fillColor, pred, param);
 	}
+	return filled;
+}
+
+/*
+ * Fills the region of the window around the point (x, y), as above. The window is read into memory once, filled
+ * there, and the part that changed is drawn back in one upload.
+ */
+template <typename BinaryColorPredicate>
+void fillWhile(int x, int y, unsigned int fillColor, const BinaryColorPredicate& pred, unsigned int param,
+	Connectivity connectivity = Connectivity::four)
+{
+	static Image image(k_xMax - k_xMin, k_yMax - k_yMin);
+	image.read();
+	image.draw(fillWhile(image, x - k_xMin, y - k_yMin, fillColor, pred, param, connectivity));
+}
+
+void floodFill(int x, int y, unsigned int interiorColor, unsigned int fillColor,
+	Connectivity connectivity = Connectivity::four)
+{
+	fillWhile(x, y, fillColor, std::equal_to<unsigned int>(), interiorColor, connectivity);
 }
 
-void floodFill(int x, int y, unsigned int interiorColor, unsigned int fillColor)
+void boundaryFill(int x, int y, unsigned int boundaryColor, unsigned int fillColor,
+	Connectivity connectivity = Connectivity::four)
 {
-	fillWhile(x, y, fillColor, std::equal_to<unsigned int>(), interiorColor);
+	fillWhile(x, y, fillColor, InsideBoundary{fillColor}, boundaryColor, connectivity);
 }
 
-void boundaryFill(int x, int y, unsigned int boundaryColor, unsigned int fillColor)
+// A flood fill of the pixels whose channels each differ from `interiorColor` by no more than those of `tolerances`.
+void toleranceFill(int x, int y, unsigned int interiorColor, unsigned int tolerances, unsigned int fillColor,
+	Connectivity connectivity = Connectivity::four)
 {
-	fillWhile(x, y, fillColor,
-		[=](unsigned int param, unsigned int pixelColor){return pixelColor != param && pixelColor != fillColor;},
-		boundaryColor);
+	fillWhile(x, y, fillColor, WithinTolerance{tolerances}, interiorColor, connectivity);
 }
 
+/*
+ * Labels every region of an image at once: two pixels share a label when a 4-connected or 8-connected path joins them
+ * on which the predicate of `fillWhile` holds throughout. Once an image is labeled, any number of regions can be filled
+ * by looking up the label of each pixel, rather than searching from every seed in turn.
+ *
+ * Labeling is union-find over pixels, split into square tiles that are labeled in parallel. Each tile joins its pixels
+ * only to neighbours inside the same tile, so tiles never touch the same entries. A serial pass then joins the pixels
+ * on either side of every seam between tiles, which is only a small fraction of the image, and a last parallel pass
+ * resolves every pixel to its root and numbers the regions from 0.
+ */
+class RegionLabeler
+{
+	private:
+		ThreadPool& m_pool;
+		int m_tileSize;
+		int m_width = 0;
+		int m_height = 0;
+		int m_regionCount = 0;
+		// The union-find forest, indexed by pixel, with -1 for pixels outside every region. Roots are their own
+		// parents, and every parent has a lower index than its child.
+		std::vector<int> m_parents;
+		// The region of each pixel, or -1.
+		std::vector<int> m_labels;
+		// For filling, the color of each region and the extent of the pixels each row of the image had set.
+		std::vector<unsigned int> m_regionColors;
+		std::vector<unsigned char> m_regionFilled;
+		std::vector<Rect> m_rowExtents;
+		
+		int findRoot(int pixel) const
+		{
+			while (m_parents[pixel] != pixel)
+				pixel = m_parents[pixel];
+			return pixel;
+		}
+		
+		// Joins the trees of two pixels in a region, making the lower root the root of both, and compresses both paths.
+		void unite(int first, int second)
+		{
+			int root = std::min(findRoot(first), findRoot(second));
+			for (int pixel: {first, second})
+			{
+				while (m_parents[pixel] != pixel)
+				{
+					int parent = m_parents[pixel];
+					m_parents[pixel] = root;
+					pixel = parent;
+				}
+				m_parents[pixel] = root;
+			}
+		}
+		
+		template <typename Body>
+		void forEachTile(const Body& body)
+		{
+			int tilesX = (m_width + m_tileSize - 1) / m_tileSize, tilesY = (m_height + m_tileSize - 1) / m_tileSize;
+			m_pool.parallelFor(static_cast<std::size_t>(tilesX)*tilesY, [&](std::size_t tile)
+			{
+				Rect rect;
+				rect.xMin = static_cast<int>(tile % tilesX)*m_tileSize;
+				rect.yMin = static_cast<int>(tile / tilesX)*m_tileSize;
+				rect.xMax = std::min(rect.xMin + m_tileSize, m_width);
+				rect.yMax = std::min(rect.yMin + m_tileSize, m_height);
+				body(rect);
+			});
+		}
+		
+	public:
+		explicit RegionLabeler(ThreadPool& pool, int tileSize = 64): m_pool(pool), m_tileSize(std::max(tileSize, 1)) {}
+		
+		int getRegionCount() const {return m_regionCount;}
+		
+		// The region of pixel (x, y) of the last image labeled, or -1 if the predicate was false there.
+		int getLabel(int x, int y) const
+		{
+			if (x < 0 || x >= m_width || y < 0 || y >= m_height)
+				return -1;
+			return m_labels[static_cast<std::size_t>(y)*m_width + x];
+		}
+		
+		// Labels the regions of `image` in which `pred(param, pixelColor)` holds.
+		template <typename BinaryColorPredicate>
+		void label(const Image& image, const BinaryColorPredicate& pred, unsigned int param,
+			Connectivity connectivity = Connectivity::four)
+		{
+			bool diagonals = connectivity == Connectivity::eight;
+			m_width = image.getWidth(), m_height = image.getHeight();
+			std::size_t size = static_cast<std::size_t>(m_width)*m_height;
+			m_parents.resize(size);
+			m_labels.resize(size);
+			forEachTile([&](const Rect& tile)
+			{
+				for (int y = tile.yMin; y < tile.yMax; ++y)
+				{
+					const unsigned int* row = image.getRow(y);
+					int* parents = &m_parents[static_cast<std::size_t>(y)*m_width];
+					for (int x = tile.xMin; x < tile.xMax; ++x)
+					{
+						int pixel = y*m_width + x;
+						if (!pred(param, row[x]))
+						{
+							parents[x] = -1;
+							continue;
+						}
+						parents[x] = pixel;
+						if (x > tile.xMin && parents[x - 1] >= 0)
+							unite(pixel - 1, pixel);
+						if (y == tile.yMin)
+							continue;
+						if (m_parents[pixel - m_width] >= 0)
+							unite(pixel - m_width, pixel);
+						if (diagonals && x > tile.xMin && m_parents[pixel - m_width - 1] >= 0)
+							unite(pixel - m_width - 1, pixel);
+						if (diagonals && x + 1 < tile.xMax && m_parents[pixel - m_width + 1] >= 0)
+							unite(pixel - m_width + 1, pixel);
+					}
+				}
+			});
+			for (int y = m_tileSize; y < m_height; y += m_tileSize)
+			{
+				for (int x = 0, pixel = y*m_width; x < m_width; ++x, ++pixel)
+				{
+					if (m_parents[pixel] < 0)
+						continue;
+					if (m_parents[pixel - m_width] >= 0)
+						unite(pixel - m_width, pixel);
+					if (diagonals && x > 0 && m_parents[pixel - m_width - 1] >= 0)
+						unite(pixel - m_width - 1, pixel);
+					if (diagonals && x + 1 < m_width && m_parents[pixel - m_width + 1] >= 0)
+						unite(pixel - m_width + 1, pixel);
+				}
+			}
+			for (int x = m_tileSize; x < m_width; x += m_tileSize)
+			{
+				for (int y = 0, pixel = x; y < m_height; ++y, pixel += m_width)
+				{
+					if (m_parents[pixel] < 0)
+						continue;
+					if (m_parents[pixel - 1] >= 0)
+						unite(pixel - 1, pixel);
+					if (diagonals && y > 0 && m_parents[pixel - m_width - 1] >= 0)
+						unite(pixel - m_width - 1, pixel);
+					if (diagonals && y + 1 < m_height && m_parents[pixel + m_width - 1] >= 0)
+						unite(pixel + m_width - 1, pixel);
+				}
+			}
+			// Roots are numbered in the order they appear, so the labels do not depend on the number of threads.
+			forEachTile([&](const Rect& tile)
+			{
+				for (int y = tile.yMin; y < tile.yMax; ++y)
+				{
+					for (int x = tile.xMin; x < tile.xMax; ++x)
+					{
+						int pixel = y*m_width + x;
+						m_labels[pixel] = m_parents[pixel] < 0 ? -1 : findRoot(pixel);
+					}
+				}
+			});
+			m_regionCount = 0;
+			for (std::size_t pixel = 0; pixel < size; ++pixel)
+			{
+				if (m_labels[pixel] == static_cast<int>(pixel))
+					m_parents[pixel] = m_regionCount++;
+			}
+			forEachTile([&](const Rect& tile)
+			{
+				for (int y = tile.yMin; y < tile.yMax; ++y)
+				{
+					int* labels = &m_labels[static_cast<std::size_t>(y)*m_width];
+					for (int x = tile.xMin; x < tile.xMax; ++x)
+					{
+						if (labels[x] >= 0)
+							labels[x] = m_parents[labels[x]];
+					}
+				}
+			});
+		}
+		
+		struct Seed
+		{
+			int x;
+			int y;
+			unsigned int color;
+		};
+		
+		/*
+		 * Sets every pixel of `image` in the region of each seed to the color of that seed, in one pass over the labels
+		 * of the last image labeled, which must have been `image`. Seeds outside every region are ignored, and if two
+		 * seeds share a region, the later one wins. Returns the smallest rectangle holding every pixel that was set.
+		 */
+		Rect fill(Image& image, const Seed* seeds, std::size_t count)
+		{
+			m_regionColors.resize(m_regionCount);
+			m_regionFilled.assign(m_regionCount, 0);
+			bool any = false;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				int region = getLabel(seeds[i].x, seeds[i].y);
+				if (region >= 0)
+					m_regionColors[region] = seeds[i].color, m_regionFilled[region] = 1, any = true;
+			}
+			Rect filled{m_width, m_height, 0, 0};
+			if (!any)
+				return filled;
+			m_rowExtents.resize(m_height);
+			m_pool.parallelFor(m_height, [&](std::size_t y)
+			{
+				unsigned int* row = image.getRow(static_cast<int>(y));
+				const int* labels = &m_labels[y*m_width];
+				Rect& extent = m_rowExtents[y];
+				extent.xMin = m_width, extent.xMax = 0;
+				for (int x = 0; x < m_width; ++x)
+				{
+					if (labels[x] >= 0 && m_regionFilled[labels[x]])
+					{
+						row[x] = m_regionColors[labels[x]];
+						extent.xMin = std::min(extent.xMin, x), extent.xMax = x + 1;
+					}
+				}
+			});
+			for (int y = 0; y < m_height; ++y)
+			{
+				const Rect& extent = m_rowExtents[y];
+				if (extent.xMin < extent.xMax)
+				{
+					filled.xMin = std::min(filled.xMin, extent.xMin), filled.xMax = std::max(filled.xMax, extent.xMax);
+					filled.yMin = std::min(filled.yMin, y), filled.yMax = y + 1;
+				}
+			}
+			return filled;
+		}
+};
+
 void drawInQuadrants(int centerX, int centerY, int x, int y)
 {
 	glBegin(GL_POINTS);
@@ -141,6 +662,43 @@ void useBoundaryFill()
 	}
 }
 
+// Draws all of the rings first, then labels the white regions of the window and fills the inside of every ring at once.
+void useRegionLabels()
+{
+	for (int i = 0; i < 5; ++i)
+	{
+		int center[2]{k_xMin + k_ringCenterOffsets[i][0], k_yMin + k_ringCenterOffsets[i][1]};
+		drawEllipse(center, k_radius, k_radius, k_ringBoundaryColors[i]);
+	}
+	static ThreadPool pool;
+	static RegionLabeler labeler(pool);
+	static Image image(k_xMax - k_xMin, k_yMax - k_yMin);
+	image.read();
+	labeler.label(image, std::equal_to<unsigned int>(), 0xFFFFFFFF);
+	RegionLabeler::Seed seeds[5];
+	for (int i = 0; i < 5; ++i)
+		seeds[i] = {k_ringCenterOffsets[i][0], k_ringCenterOffsets[i][1], k_ringFillColors[i]};
+	image.draw(labeler.fill(image, seeds, 5));
+	glFlush();
+}
+
+// Fills the rings from their equations, painting each interior and then its outline, with no outline to search.
+void useSpanFill()
+{
+	GLSink sink;
+	sink.begin();
+	for (int i = 0; i < 5; ++i)
+	{
+		int center[2]{k_xMin + k_ringCenterOffsets[i][0], k_yMin + k_ringCenterOffsets[i][1]};
+		sink.setColor(k_ringFillColors[i]);
+		fillEllipseInterior(sink, center[0], center[1], k_radius, k_radius);
+		sink.setColor(k_ringBoundaryColors[i]);
+		fillAnnulus(sink, center[0], center[1], k_radius, k_radius, k_radius, k_radius);
+	}
+	sink.end();
+}
+
+// Usage: ringfill [--labels | --spans]
 int main(int argc, char** argv)
 {
 	glutInit(&argc, argv);
@@ -149,7 +707,12 @@ int main(int argc, char** argv)
 	glutInitWindowSize(k_xMax - k_xMin, k_yMax - k_yMin);
 	glutCreateWindow("Olympic Rings");
 	init();
-	glutDisplayFunc(useFloodFill);
+	void (*display)() = useFloodFill;
+	if (argc >= 2 && !std::strcmp(argv[1], "--labels"))
+		display = useRegionLabels;
+	else if (argc >= 2 && !std::strcmp(argv[1], "--spans"))
+		display = useSpanFill;
+	glutDisplayFunc(display);
 	glutMainLoop();
 	return 0;
 }
\ No newline at end of file
@@ -1,10 +1,18 @@
-#include <windows.h>
-#include <GL/glut.h>
+#include "raster.h"
+#include "thread_pool.h"
+#include "arena.h"
+#include "polygon_dataset.h"
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <array>
 #include <vector>
 #include <algorithm>
-#include <list>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 constexpr int k_xMin = 0;
 constexpr int k_yMin = 0;
@@ -13,80 +21,105 @@ constexpr int k_yMax = 300;
 constexpr int k_width = k_xMax - k_xMin;
 constexpr int k_height = k_yMax - k_yMin;
 
-double copySignum(double x, double y)
+// The part of the plane that is drawn to: columns `xMin` to `xMax` - 1 and rows `yMin` to `yMax` - 1.
+struct Canvas
 {
-	return y ? std::copysign(x, y) : 0.0;
+	int xMin;
+	int yMin;
+	int xMax;
+	int yMax;
+	
+	int getWidth() const {return xMax - xMin;}
+	int getHeight() const {return yMax - yMin;}
+};
+
+constexpr Canvas k_window{k_xMin, k_yMin, k_xMax, k_yMax};
+
+constexpr int k_subpixelBits = 4;
+constexpr int k_subpixelScale = 1 << k_subpixelBits;
+
+// Division rounding toward negative and positive infinity, for a positive `denominator`.
+std::int64_t floorDivide(std::int64_t numerator, std::int64_t denominator)
+{
+	return numerator / denominator - (numerator % denominator < 0);
 }
 
-void lineBresenham(int x1, int y1, int x2, int y2)
+std::int64_t ceilDivide(std::int64_t numerator, std::int64_t denominator)
 {
-	int deltaX = std::abs(x2 - x1), deltaY = std::abs(y2 - y1);
-	int x = x1, y = y1;
-	int *domainVar, *rangeVar, *domainDelta, *rangeDelta;
-	int domainStep, rangeStep;
-	if (deltaX > deltaY)
-	{
-		domainVar = &x, rangeVar = &y;
-		domainDelta = &deltaX, rangeDelta = &deltaY;
-		domainStep = static_cast<int>(copySignum(1.0, x2 - x1));
-		rangeStep = static_cast<int>(copySignum(1.0, y2 - y1));
-	}
-	else
-	{
-		domainVar = &y, rangeVar = &x;
-		domainDelta = &deltaY, rangeDelta = &deltaX;
-		domainStep = static_cast<int>(copySignum(1.0, y2 - y1));
-		rangeStep = static_cast<int>(copySignum(1.0, x2 - x1));
-	}
-	int p = 2*(*rangeDelta) - *domainDelta;
-	// `d_lower` and `d_upper` are special cases of `d_same` and `d_changed` for when slope is positive.
-	int same = 2*(*rangeDelta);
-	int changed = same - 2*(*domainDelta);
-	for (int i = 0; i < *domainDelta; ++i)
-	{
-		glVertex2i(x, y);
-		*domainVar += domainStep;
-		if (p < 0)
-			p += same;
-		else
-		{
-			p += changed;
-			*rangeVar += rangeStep;
-		}
-	}
+	return -floorDivide(-numerator, denominator);
 }
 
+/*
+ * The first row whose centre is at or above `y`, in sub-pixel units. Pixel (x, y) has its centre at (x + 1/2, y + 1/2),
+ * and a side from `y1` up to `y2` crosses the centres of the rows from `firstRow(y1)` up to, but not including,
+ * `firstRow(y2)`.
+ */
+int firstRow(int y)
+{
+	return static_cast<int>(ceilDivide(y - k_subpixelScale/2, k_subpixelScale));
+}
+
+/*
+ * A read-only view of the sides of a polygon, each {x1, y1, x2, y2}. It is made implicitly from a vector, or from a pointer
+ * and a count, so that sides stored elsewhere, such as in a memory-mapped file, can be filled without being copied.
+ */
+class SideList
+{
+	private:
+		const std::array<int, 4>* m_data;
+		std::size_t m_size;
+		
+	public:
+		SideList(const std::vector<std::array<int, 4>>& sides): m_data(sides.data()), m_size(sides.size()) {}
+		SideList(const std::array<int, 4>* data, std::size_t size): m_data(data), m_size(size) {}
+		
+		const std::array<int, 4>* begin() const {return m_data;}
+		const std::array<int, 4>* end() const {return m_data + m_size;}
+		std::size_t size() const {return m_size;}
+};
+
+/*
+ * A side stepped from the centre of one row to the next. Where the side crosses a row, `m_intercept` is the first pixel
+ * whose centre lies on or to the right of it, ceil(N/D) for a numerator N that grows by the same amount every row.
+ * `m_remainder` holds `m_intercept`*D - N, the exact fraction that the rounding left over, so that stepping to the next
+ * row needs nothing but additions and one comparison.
+ */
 class Side
 {
 	private:
 		int m_intercept;
 		int m_maxY;
-		int m_deltaX;
-		int m_deltaY;
-		int m_counter = 0;
+		int m_step;
+		std::int64_t m_remainder;
+		std::int64_t m_remainderStep;
+		std::int64_t m_denominator;
 		
 	public:
-		Side(int startX, int maxY, int deltaX, int deltaY):
-			m_intercept(startX), m_maxY(maxY), m_deltaX(deltaX), m_deltaY(deltaY) {}
-			
-		Side(const Side& other):
-			m_intercept(other.m_intercept), m_maxY(other.m_maxY), m_deltaX(other.m_deltaX), m_deltaY(other.m_deltaY) {}
-			
-		Side(Side&& other):
-			m_intercept(other.m_intercept), m_maxY(other.m_maxY), m_deltaX(other.m_deltaX), m_deltaY(other.m_deltaY) {}
-			
+		Side() = default;
+		
+		// The side from (`x1`, `y1`) to (`x2`, `y2`), in sub-pixel units with `y1` < `y2`, covering rows `y` to `maxY` - 1.
+		Side(int x1, int y1, int x2, int y2, int y, int maxY): m_maxY(maxY)
+		{
+			std::int64_t deltaX = x2 - x1, deltaY = y2 - y1;
+			m_denominator = k_subpixelScale*deltaY;
+			std::int64_t numerator = (x1 - k_subpixelScale/2)*deltaY
+				+ (static_cast<std::int64_t>(y)*k_subpixelScale + k_subpixelScale/2 - y1)*deltaX;
+			m_intercept = static_cast<int>(ceilDivide(numerator, m_denominator));
+			m_remainder = m_intercept*m_denominator - numerator;
+			// One row adds `k_subpixelScale`*`deltaX` to N, which is `m_step` whole pixels and `m_remainderStep` over.
+			m_step = static_cast<int>(floorDivide(deltaX, deltaY));
+			m_remainderStep = k_subpixelScale*(deltaX - m_step*deltaY);
+		}
+		
 		int getIntercept() const {return m_intercept;}
 		int getMaxY() const {return m_maxY;}
 		
 		void incrY()
 		{
-			int div = m_counter / m_deltaY;
-			if (div)
-			{
-				m_intercept += div;
-				m_counter %= m_deltaY;
-			}
-			m_counter += m_deltaX;
+			m_intercept += m_step;
+			m_remainder -= m_remainderStep;
+			if (m_remainder < 0)
+				m_remainder += m_denominator, ++m_intercept;
 		}
 		
 		friend bool operator<(const Side& first, const Side& second);
@@ -97,50 +130,1045 @@ bool operator<(const Side& first, const Side& second)
 	return first.m_intercept < second.m_intercept;
 }
 
-void initRows(std::list<Side> rows[k_height], std::vector<std::array<int, 4>>& sides)
+/*
+ * Fills polygons given as lists of sides {x1, y1, x2, y2} under the even-odd rule. The result is a list of `Span`s, which
+ * can be kept by the caller or handed to a sink in one call.
+ *
+ * A pixel is filled when its centre is inside the polygon. A centre that lies exactly on a side counts as inside when the
+ * side is a left side, or a bottom side, of the polygon: spans are half-open, from the first centre at or right of one
+ * intercept to the last centre left of the next, and sides cover the rows from the first centre at or above their lower
+ * end to the last centre below their upper end. This is the top-left rule, flipped vertically because row 0 is at the
+ * bottom. Polygons that share a side therefore fill every pixel along it exactly once.
+ *
+ * The edge table is a single array of sides bucketed by the row they start on, built with a counting sort. The active
+ * edge table is an array as well. From one row to the next it changes only where sides end, start or cross, so it is
+ * nearly sorted and an insertion sort puts it back in order in close to linear time. Both tables are drawn from a
+ * `FrameArena` that is reset at the start of every scan, so once it has grown to fit the largest polygon, filling
+ * allocates nothing. The canvas is set at run time; its height only decides the size of the edge table's row index.
+ */
+class ScanFiller
 {
-	auto *sideOne = &sides.at(sides.size() - 2), *sideTwo = &sides.at(sides.size() - 1);
-	for (int i = 0; i < sides.size(); ++i)
-	{
-		int &y1 = (*sideOne)[1], &y2 = (*sideOne)[3], &y3 = (*sideTwo)[3];
-		if (y1 != y2)
+	private:
+		Canvas m_canvas;
+		FrameArena m_arena;
+		// The sides starting on row `i` are `m_edges[m_rowEnds[i - 1]]` up to `m_edges[m_rowEnds[i]]`, with
+		// `m_rowEnds[-1]` taken as 0. These point into `m_arena`, and only during a scan.
+		int* m_rowEnds = nullptr;
+		Side* m_edges = nullptr;
+		Side* m_activeSides = nullptr;
+		std::size_t m_activeCount = 0;
+		std::vector<Span> m_spans;
+		
+		/*
+		 * Builds the edge table for rows `yBegin` to `yEnd` - 1 from `sides`, whose coordinates are multiplied by `scale`
+		 * to get sub-pixel units. A side that starts below `yBegin` is entered on that row, already stepped to it.
+		 */
+		void buildEdgeTable(SideList sides, int scale, int yBegin, int yEnd)
 		{
-			if (y1 < y2)
-				rows[y1 - k_yMin].emplace_back((*sideOne)[0], y2, (*sideOne)[2] - (*sideOne)[0], y2 - y1);
-			else
-				rows[y2 - k_yMin].emplace_back((*sideOne)[2], y1, (*sideOne)[0] - (*sideOne)[2], y1 - y2);
+			auto rowsOf = [=](int y1, int y2, int& y, int& maxY)
+			{
+				y = std::max(firstRow(y1), yBegin), maxY = std::min(firstRow(y2), yEnd);
+				return y < maxY;
+			};
+			// Counting each side at the row after its own turns the prefix sum into each row's start. Placing the
+			// sides then advances every start to the row's end.
+			int height = yEnd - yBegin;
+			m_rowEnds = m_arena.allocate<int>(height + 1);
+			std::fill_n(m_rowEnds, height + 1, 0);
+			for (const std::array<int, 4>& side: sides)
+			{
+				int y, maxY;
+				if (rowsOf(std::min(side[1], side[3])*scale, std::max(side[1], side[3])*scale, y, maxY))
+					++m_rowEnds[y - yBegin + 1];
+			}
+			for (int i = 1; i <= height; ++i)
+				m_rowEnds[i] += m_rowEnds[i - 1];
+			m_edges = m_arena.allocate<Side>(m_rowEnds[height]);
+			m_activeSides = m_arena.allocate<Side>(m_rowEnds[height]);
+			for (const std::array<int, 4>& side: sides)
+			{
+				int x1 = side[0]*scale, y1 = side[1]*scale, x2 = side[2]*scale, y2 = side[3]*scale;
+				if (y1 > y2)
+					std::swap(x1, x2), std::swap(y1, y2);
+				int y, maxY;
+				if (rowsOf(y1, y2, y, maxY))
+					m_edges[m_rowEnds[y - yBegin]++] = Side(x1, y1, x2, y2, y, maxY);
+			}
 		}
-		sideOne = sideTwo, sideTwo = &sides[i];
-	}
-	for (int i = 0; i < k_height; ++i)
-		rows[i].sort();
+		
+		void scanScaled(SideList sides, int scale, std::vector<Span>& spans, int yBegin, int yEnd)
+		{
+			m_arena.reset();
+			buildEdgeTable(sides, scale, yBegin, yEnd);
+			m_activeCount = 0;
+			for (int i = 0, y = yBegin; y < yEnd; ++i, ++y)
+			{
+				updateActiveSides(i, y);
+				for (std::size_t j = 0; j + 1 < m_activeCount; j += 2)
+				{
+					int xStart = m_activeSides[j].getIntercept(), xEnd = m_activeSides[j + 1].getIntercept();
+					if (xStart < xEnd)
+						spans.push_back({y, xStart, xEnd});
+				}
+				for (std::size_t j = 0; j < m_activeCount; ++j)
+					m_activeSides[j].incrY();
+			}
+		}
+		
+		// Drops the sides that end before row `y`, adds those that start on it, and sorts the result by intercept.
+		void updateActiveSides(int row, int y)
+		{
+			m_activeCount = std::remove_if(m_activeSides, m_activeSides + m_activeCount,
+				[=](const Side& s){return y >= s.getMaxY();}) - m_activeSides;
+			m_activeCount = std::copy(m_edges + (row ? m_rowEnds[row - 1] : 0), m_edges + m_rowEnds[row],
+				m_activeSides + m_activeCount) - m_activeSides;
+			for (std::size_t i = 1; i < m_activeCount; ++i)
+			{
+				Side side = m_activeSides[i];
+				std::size_t j = i;
+				for (; j > 0 && side < m_activeSides[j - 1]; --j)
+					m_activeSides[j] = m_activeSides[j - 1];
+				m_activeSides[j] = side;
+			}
+		}
+		
+	public:
+		explicit ScanFiller(const Canvas& canvas = k_window): m_canvas(canvas) {}
+		
+		const Canvas& getCanvas() const {return m_canvas;}
+		
+		/*
+		 * Appends the spans of a polygon whose vertices are pixel corners to `spans`, bottom row first and from left to
+		 * right within a row. Empty spans are left out, as are rows outside the canvas.
+		 */
+		void scan(SideList sides, std::vector<Span>& spans)
+		{
+			scanScaled(sides, k_subpixelScale, spans, m_canvas.yMin, m_canvas.yMax);
+		}
+		
+		// As `scan`, but only for rows `yBegin` to `yEnd` - 1, which must lie within the canvas.
+		void scan(SideList sides, std::vector<Span>& spans, int yBegin, int yEnd)
+		{
+			scanScaled(sides, k_subpixelScale, spans, yBegin, yEnd);
+		}
+		
+		// As `scan`, for a polygon whose coordinates are in units of 1/`k_subpixelScale` pixel.
+		void scanSubpixel(SideList sides, std::vector<Span>& spans)
+		{
+			scanScaled(sides, 1, spans, m_canvas.yMin, m_canvas.yMax);
+		}
+		
+		void scanSubpixel(SideList sides, std::vector<Span>& spans, int yBegin, int yEnd)
+		{
+			scanScaled(sides, 1, spans, yBegin, yEnd);
+		}
+		
+		// Scans the polygon into a buffer of its own and hands all of the spans to `sink` at once.
+		template <typename Sink>
+		void fill(Sink& sink, SideList sides)
+		{
+			m_spans.clear();
+			scan(sides, m_spans);
+			sink.fillSpans(m_spans.data(), m_spans.size());
+		}
+		
+		template <typename Sink>
+		void fillSubpixel(Sink& sink, SideList sides)
+		{
+			m_spans.clear();
+			scanSubpixel(sides, m_spans);
+			sink.fillSpans(m_spans.data(), m_spans.size());
+		}
+};
+
+/*
+ * Scan converts polygons on a thread pool, split into horizontal bands of the canvas. Each band has a `ScanFiller` of its
+ * own, whose edge table holds only the sides crossing the band, each already stepped to the band's first row, so the
+ * bands share no state while they are filled. Every band collects its spans separately and the lists are joined in band
+ * order, which gives exactly the spans `ScanFiller` would, in the same order.
+ *
+ * Every band visits every side while building its edge table, so the bands should not be much thinner than they need to
+ * be to keep the threads busy. By default there are four per thread.
+ */
+class BandedScanFiller
+{
+	private:
+		ThreadPool& m_pool;
+		Canvas m_canvas;
+		std::vector<ScanFiller> m_fillers;
+		std::vector<std::vector<Span>> m_bandSpans;
+		std::vector<Span> m_spans;
+		
+		void scanScaled(SideList sides, bool subpixel, std::vector<Span>& spans)
+		{
+			int bandCount = static_cast<int>(m_fillers.size());
+			int bandHeight = (m_canvas.getHeight() + bandCount - 1) / bandCount;
+			m_pool.parallelFor(m_fillers.size(), [&](std::size_t band)
+			{
+				int yBegin = m_canvas.yMin + static_cast<int>(band)*bandHeight;
+				int yEnd = std::min(yBegin + bandHeight, m_canvas.yMax);
+				m_bandSpans[band].clear();
+				if (yBegin >= yEnd)
+					return;
+				if (subpixel)
+					m_fillers[band].scanSubpixel(sides, m_bandSpans[band], yBegin, yEnd);
+				else
+					m_fillers[band].scan(sides, m_bandSpans[band], yBegin, yEnd);
+			});
+			for (const std::vector<Span>& bandSpans: m_bandSpans)
+				spans.insert(spans.end(), bandSpans.begin(), bandSpans.end());
+		}
+		
+	public:
+		// A `bandCount` of zero picks four bands per thread of `pool`.
+		explicit BandedScanFiller(ThreadPool& pool, const Canvas& canvas = k_window, int bandCount = 0):
+			m_pool(pool), m_canvas(canvas)
+		{
+			if (bandCount <= 0)
+				bandCount = 4*static_cast<int>(pool.getThreadCount());
+			bandCount = std::max(std::min(bandCount, canvas.getHeight()), 1);
+			m_fillers.reserve(bandCount);
+			for (int i = 0; i < bandCount; ++i)
+				m_fillers.emplace_back(canvas);
+			m_bandSpans.resize(bandCount);
+		}
+		
+		void scan(SideList sides, std::vector<Span>& spans)
+		{
+			scanScaled(sides, false, spans);
+		}
+		
+		void scanSubpixel(SideList sides, std::vector<Span>& spans)
+		{
+			scanScaled(sides, true, spans);
+		}
+		
+		template <typename Sink>
+		void fill(Sink& sink, SideList sides)
+		{
+			m_spans.clear();
+			scan(sides, m_spans);
+			sink.fillSpans(m_spans.data(), m_spans.size());
+		}
+		
+		template <typename Sink>
+		void fillSubpixel(Sink& sink, SideList sides)
+		{
+			m_spans.clear();
+			scanSubpixel(sides, m_spans);
+			sink.fillSpans(m_spans.data(), m_spans.size());
+		}
+};
+
+// The index of the highest set bit of a non-zero `word`.
+int highestBit(std::uint64_t word)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, word);
+	return static_cast<int>(index);
+#else
+	return 63 - __builtin_clzll(word);
+#endif
 }
 
-void scanFill(std::vector<std::array<int, 4>>& sides)
+/*
+ * A set of small integers that finds its largest element in a few steps however many it holds. Level 0 has a bit for
+ * every element, and each word of every level above has a bit for every non-zero word of the level below, up to a single
+ * word at the top. Finding the largest element reads one word per level.
+ */
+class HierarchicalBitset
 {
-	std::list<Side> rows[k_height];
-	initRows(rows, sides);
-	std::list<Side> activeSides;
-	for (int i = 0, y = k_yMin; i < k_height; ++i, ++y)
+	private:
+		std::vector<std::vector<std::uint64_t>> m_levels;
+		
+	public:
+		// Empties the set and makes room for the elements 0 to `size` - 1.
+		void reset(std::size_t size)
+		{
+			std::size_t levels = 0;
+			do
+			{
+				size = (size + 63) / 64;
+				if (m_levels.size() == levels)
+					m_levels.emplace_back();
+				m_levels[levels++].assign(size, 0);
+			}
+			while (size > 1);
+			m_levels.resize(levels);
+		}
+		
+		void insert(std::size_t element)
+		{
+			for (std::vector<std::uint64_t>& level: m_levels)
+			{
+				std::uint64_t& word = level[element / 64];
+				bool wasEmpty = !word;
+				word |= std::uint64_t(1) << element % 64;
+				if (!wasEmpty)
+					break;
+				element /= 64;
+			}
+		}
+		
+		void erase(std::size_t element)
+		{
+			for (std::vector<std::uint64_t>& level: m_levels)
+			{
+				std::uint64_t& word = level[element / 64];
+				word &= ~(std::uint64_t(1) << element % 64);
+				if (word)
+					break;
+				element /= 64;
+			}
+		}
+		
+		// The largest element, or -1 if the set is empty.
+		long long findLast() const
+		{
+			if (!m_levels.back()[0])
+				return -1;
+			std::size_t element = 0;
+			for (std::size_t level = m_levels.size(); level-- > 0;)
+				element = element*64 + highestBit(m_levels[level][element]);
+			return static_cast<long long>(element);
+		}
+};
+
+enum class FillRule
+{
+	evenOdd,
+	nonZero
+};
+
+/*
+ * Renders a scene of many polygons at once, each with its own color, priority and fill rule. Where polygons overlap, the
+ * one with the highest priority is drawn, and of those with equal priority, the one added last; every pixel is written
+ * once, by that polygon, rather than once for every polygon that covers it.
+ *
+ * The sides of all the polygons go into one edge table, bucketed by row as in `ScanFiller`, and each row is resolved in a
+ * single sweep of one active edge table. The sweep keeps a winding number for every polygon, adding one for each side
+ * that it crosses going up and subtracting one for each going down, and a polygon is inside where its rule holds for its
+ * winding number: odd for `FillRule::evenOdd`, non-zero for `FillRule::nonZero`. The polygons that are inside are kept in
+ * a `HierarchicalBitset` indexed by their rank in drawing order, so the one on top is its largest element. Pixels follow
+ * the same rules as in `ScanFiller`.
+ */
+class SceneRenderer
+{
+	private:
+		struct SceneSide
+		{
+			std::array<int, 4> side;
+			int polygon;
+		};
+		
+		struct Edge
+		{
+			Side side;
+			int polygon;
+			int winding;
+		};
+		
+		struct Polygon
+		{
+			unsigned int color;
+			int priority;
+			FillRule rule;
+			int rank;
+			int winding;
+		};
+		
+		Canvas m_canvas;
+		std::vector<SceneSide> m_sides;
+		std::vector<Polygon> m_polygons;
+		// The working storage of `render`, drawn from `m_arena`.
+		FrameArena m_arena;
+		int* m_order = nullptr;
+		int* m_rowEnds = nullptr;
+		Edge* m_edges = nullptr;
+		Edge* m_activeEdges = nullptr;
+		std::size_t m_activeCount = 0;
+		HierarchicalBitset m_inside;
+		
+		void addSides(SideList sides, int scale, unsigned int color, int priority, FillRule rule)
+		{
+			int polygon = static_cast<int>(m_polygons.size());
+			m_polygons.push_back({color, priority, rule, 0, 0});
+			for (const std::array<int, 4>& side: sides)
+				m_sides.push_back({{side[0]*scale, side[1]*scale, side[2]*scale, side[3]*scale}, polygon});
+		}
+		
+		// Ranks the polygons in drawing order, so that a higher rank is drawn over a lower one.
+		void rankPolygons()
+		{
+			std::size_t count = m_polygons.size();
+			m_order = m_arena.allocate<int>(count);
+			for (std::size_t i = 0; i < count; ++i)
+				m_order[i] = static_cast<int>(i);
+			// Ties go to the polygon added last. Breaking them by index, rather than with `std::stable_sort`, avoids the
+			// buffer that it allocates.
+			std::sort(m_order, m_order + count, [this](int first, int second)
+			{
+				int firstPriority = m_polygons[first].priority, secondPriority = m_polygons[second].priority;
+				return firstPriority < secondPriority || (firstPriority == secondPriority && first < second);
+			});
+			for (std::size_t i = 0; i < count; ++i)
+				m_polygons[m_order[i]].rank = static_cast<int>(i);
+		}
+		
+		// As `ScanFiller::buildEdgeTable`, for the sides of every polygon; sides going down get a winding of -1.
+		void buildEdgeTable()
+		{
+			const Canvas& canvas = m_canvas;
+			auto rowsOf = [&canvas](int y1, int y2, int& y, int& maxY)
+			{
+				y = std::max(firstRow(y1), canvas.yMin), maxY = std::min(firstRow(y2), canvas.yMax);
+				return y < maxY;
+			};
+			int height = m_canvas.getHeight();
+			m_rowEnds = m_arena.allocate<int>(height + 1);
+			std::fill_n(m_rowEnds, height + 1, 0);
+			for (const SceneSide& side: m_sides)
+			{
+				int y, maxY;
+				if (rowsOf(std::min(side.side[1], side.side[3]), std::max(side.side[1], side.side[3]), y, maxY))
+					++m_rowEnds[y - m_canvas.yMin + 1];
+			}
+			for (int i = 1; i <= height; ++i)
+				m_rowEnds[i] += m_rowEnds[i - 1];
+			m_edges = m_arena.allocate<Edge>(m_rowEnds[height]);
+			m_activeEdges = m_arena.allocate<Edge>(m_rowEnds[height]);
+			for (const SceneSide& side: m_sides)
+			{
+				int x1 = side.side[0], y1 = side.side[1], x2 = side.side[2], y2 = side.side[3], winding = 1;
+				if (y1 > y2)
+					std::swap(x1, x2), std::swap(y1, y2), winding = -1;
+				int y, maxY;
+				if (rowsOf(y1, y2, y, maxY))
+					m_edges[m_rowEnds[y - m_canvas.yMin]++] = {Side(x1, y1, x2, y2, y, maxY), side.polygon, winding};
+			}
+		}
+		
+		void updateActiveEdges(int row, int y)
+		{
+			m_activeCount = std::remove_if(m_activeEdges, m_activeEdges + m_activeCount,
+				[=](const Edge& e){return y >= e.side.getMaxY();}) - m_activeEdges;
+			m_activeCount = std::copy(m_edges + (row ? m_rowEnds[row - 1] : 0), m_edges + m_rowEnds[row],
+				m_activeEdges + m_activeCount) - m_activeEdges;
+			for (std::size_t i = 1; i < m_activeCount; ++i)
+			{
+				Edge edge = m_activeEdges[i];
+				std::size_t j = i;
+				for (; j > 0 && edge.side < m_activeEdges[j - 1].side; --j)
+					m_activeEdges[j] = m_activeEdges[j - 1];
+				m_activeEdges[j] = edge;
+			}
+		}
+		
+		bool isInside(const Polygon& polygon) const
+		{
+			return polygon.rule == FillRule::evenOdd ? polygon.winding & 1 : polygon.winding != 0;
+		}
+		
+	public:
+		explicit SceneRenderer(const Canvas& canvas = k_window): m_canvas(canvas) {}
+		
+		// Removes every polygon, keeping the storage for the next scene.
+		void clear()
+		{
+			m_sides.clear();
+			m_polygons.clear();
+		}
+		
+		// Adds a polygon whose vertices are pixel corners.
+		void addPolygon(SideList sides, unsigned int color, int priority, FillRule rule = FillRule::evenOdd)
+		{
+			addSides(sides, k_subpixelScale, color, priority, rule);
+		}
+		
+		// Adds a polygon whose coordinates are in units of 1/`k_subpixelScale` pixel.
+		void addSubpixelPolygon(SideList sides, unsigned int color, int priority, FillRule rule = FillRule::evenOdd)
+		{
+			addSides(sides, 1, color, priority, rule);
+		}
+		
+		// Draws the scene as horizontal spans, each in the color of the polygon on top. Neighboring spans of the same
+		// polygon are joined.
+		template <typename Sink>
+		void render(Sink& sink)
+		{
+			if (m_polygons.empty())
+				return;
+			m_arena.reset();
+			rankPolygons();
+			buildEdgeTable();
+			m_inside.reset(m_polygons.size());
+			m_activeCount = 0;
+			bool colorSet = false;
+			unsigned int color = 0;
+			for (int i = 0, y = m_canvas.yMin; y < m_canvas.yMax; ++i, ++y)
+			{
+				updateActiveEdges(i, y);
+				// The span being built, which is drawn once the next one turns out not to continue it.
+				int spanStart = 0, spanEnd = 0, spanRank = -1;
+				auto flush = [&]
+				{
+					if (spanRank < 0 || spanStart >= spanEnd)
+						return;
+					const Polygon& polygon = m_polygons[m_order[spanRank]];
+					if (!colorSet || polygon.color != color)
+						sink.setColor(color = polygon.color), colorSet = true;
+					sink.setHSpan(spanStart, y, spanEnd - spanStart);
+				};
+				int x = 0;
+				for (std::size_t j = 0; j < m_activeCount; ++j)
+				{
+					const Edge& edge = m_activeEdges[j];
+					int nextX = edge.side.getIntercept();
+					if (nextX > x)
+					{
+						int top = static_cast<int>(m_inside.findLast());
+						if (top >= 0 && top == spanRank && x == spanEnd)
+							spanEnd = nextX;
+						else if (top >= 0)
+						{
+							flush();
+							spanStart = x, spanEnd = nextX, spanRank = top;
+						}
+					}
+					x = nextX;
+					Polygon& polygon = m_polygons[edge.polygon];
+					bool wasInside = isInside(polygon);
+					polygon.winding += edge.winding;
+					if (isInside(polygon) != wasInside)
+					{
+						if (wasInside)
+							m_inside.erase(polygon.rank);
+						else
+							m_inside.insert(polygon.rank);
+					}
+				}
+				flush();
+				for (std::size_t j = 0; j < m_activeCount; ++j)
+				{
+					Edge& edge = m_activeEdges[j];
+					edge.side.incrY();
+					// Closed polygons always end a row outside, but an open one would leave its winding behind.
+					Polygon& polygon = m_polygons[edge.polygon];
+					if (polygon.winding)
+						m_inside.erase(polygon.rank), polygon.winding = 0;
+				}
+			}
+		}
+};
+
+/*
+ * Antialiased polygon fill by signed-area accumulation, as in font rasterizers such as font-rs. Every side adds, to each
+ * cell it passes through, the signed area between itself and the cell's left edge, and to the cell after it the rest of
+ * its height, so that a running sum along a row gives every pixel the exact fraction of it that the polygon covers. One
+ * pass over the sides, and one over the cells, does the whole polygon, however finely its edges are placed.
+ *
+ * The running sum counts coverage with the non-zero rule, capped at full coverage. `resolve` turns it into alpha and blends
+ * the color into a `Framebuffer`, taking the prefix sum four cells at a time with SSE2, and clears the cells for the next
+ * polygon. Coordinates are in canvas space; sides may extend past it, since parts left of the canvas become vertical lines
+ * along its left edge and parts right of it are dropped.
+ */
+class CoverageRasterizer
+{
+	private:
+		int m_xMin;
+		int m_yMin;
+		int m_width;
+		int m_height;
+		// Each row has two extra cells, for sides lying on the right edge of the canvas.
+		int m_stride;
+		std::vector<float> m_cells;
+		std::vector<unsigned char> m_coverages;
+		
+		float clampX(float x) const {return std::min(std::max(x, 0.0f), static_cast<float>(m_width));}
+		
+		/*
+		 * Accumulates the side from (`x0`, `y0`) to (`x1`, `y1`), where 0 <= `x0`, `x1` <= `m_width`. Rounding can carry
+		 * the points stepped to in between slightly past those bounds, so they are clamped as well, or a side along the
+		 * left edge could reach the cell before its row.
+		 */
+		void addLine(float x0, float y0, float x1, float y1)
+		{
+			if (y0 == y1)
+				return;
+			float direction = 1.0f;
+			if (y0 > y1)
+				std::swap(x0, x1), std::swap(y0, y1), direction = -1.0f;
+			float slope = (x1 - x0) / (y1 - y0);
+			float x = x0;
+			if (y0 < 0.0f)
+				x = clampX(x - y0*slope);
+			int yEnd = std::min(m_height, static_cast<int>(std::ceil(y1)));
+			for (int y = std::max(0, static_cast<int>(y0)); y < yEnd; ++y)
+			{
+				float* row = &m_cells[static_cast<std::size_t>(y)*m_stride];
+				float deltaY = std::min(y + 1.0f, y1) - std::max(static_cast<float>(y), y0);
+				float xNext = clampX(x + slope*deltaY);
+				float height = deltaY*direction;
+				float left = std::min(x, xNext), right = std::max(x, xNext);
+				float leftFloor = std::floor(left), rightCeil = std::ceil(right);
+				int leftCell = static_cast<int>(leftFloor), rightCell = static_cast<int>(rightCeil);
+				if (rightCell <= leftCell + 1)
+				{
+					// The side stays within one cell on this row.
+					float middle = 0.5f*(x + xNext) - leftFloor;
+					row[leftCell] += height - height*middle;
+					row[leftCell + 1] += height*middle;
+				}
+				else
+				{
+					float inverseWidth = 1.0f / (right - left);
+					float leftFraction = left - leftFloor;
+					float firstArea = 0.5f*inverseWidth*(1.0f - leftFraction)*(1.0f - leftFraction);
+					float rightFraction = right - rightCeil + 1.0f;
+					float lastArea = 0.5f*inverseWidth*rightFraction*rightFraction;
+					row[leftCell] += height*firstArea;
+					if (rightCell == leftCell + 2)
+						row[leftCell + 1] += height*(1.0f - firstArea - lastArea);
+					else
+					{
+						float area = inverseWidth*(1.5f - leftFraction);
+						row[leftCell + 1] += height*(area - firstArea);
+						for (int cell = leftCell + 2; cell < rightCell - 1; ++cell)
+							row[cell] += height*inverseWidth;
+						area += (rightCell - leftCell - 3)*inverseWidth;
+						row[rightCell - 1] += height*(1.0f - area - lastArea);
+					}
+					row[rightCell] += height*lastArea;
+				}
+				x = xNext;
+			}
+		}
+		
+		// Splits the side where it leaves the canvas on the left or right, and accumulates the pieces that matter.
+		void addClippedLine(float x0, float y0, float x1, float y1)
+		{
+			float cuts[4] = {0.0f, 1.0f, 1.0f, 1.0f};
+			int cutCount = 1;
+			for (float edge: {0.0f, static_cast<float>(m_width)})
+			{
+				if ((x0 < edge) != (x1 < edge))
+					cuts[cutCount++] = (edge - x0) / (x1 - x0);
+			}
+			// There are at most two cuts, one for each edge.
+			if (cutCount == 3 && cuts[1] > cuts[2])
+				std::swap(cuts[1], cuts[2]);
+			cuts[cutCount] = 1.0f;
+			for (int i = 0; i < cutCount; ++i)
+			{
+				float startX = x0 + (x1 - x0)*cuts[i], startY = y0 + (y1 - y0)*cuts[i];
+				float endX = x0 + (x1 - x0)*cuts[i + 1], endY = y0 + (y1 - y0)*cuts[i + 1];
+				float middleX = 0.5f*(startX + endX);
+				if (middleX >= m_width)
+					continue;
+				if (middleX <= 0.0f)
+					addLine(0.0f, startY, 0.0f, endY);
+				else
+					addLine(clampX(startX), startY, clampX(endX), endY);
+			}
+		}
+		
+		// Turns row `y` of the cells into coverages from 0 to 255, and clears it.
+		void accumulateRow(int y)
+		{
+			float* row = &m_cells[static_cast<std::size_t>(y)*m_stride];
+			int x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+			const __m128 signMask = _mm_set1_ps(-0.0f), one = _mm_set1_ps(1.0f);
+			const __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+			__m128 offset = _mm_setzero_ps();
+			for (; x + 4 <= m_width; x += 4)
+			{
+				// An inclusive prefix sum of four cells in two shifted additions, carried on from the cells before.
+				__m128 sum = _mm_loadu_ps(row + x);
+				sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 4)));
+				sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 8)));
+				sum = _mm_add_ps(sum, offset);
+				__m128 coverage = _mm_min_ps(_mm_andnot_ps(signMask, sum), one);
+				__m128i bytes = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(coverage, scale), half));
+				bytes = _mm_packus_epi16(_mm_packs_epi32(bytes, bytes), bytes);
+				int packed = _mm_cvtsi128_si32(bytes);
+				std::memcpy(&m_coverages[x], &packed, 4);
+				offset = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 3, 3));
+			}
+			float sum = _mm_cvtss_f32(offset);
+#else
+			float sum = 0.0f;
+#endif
+			for (; x < m_width; ++x)
+			{
+				sum += row[x];
+				float coverage = std::min(std::abs(sum), 1.0f);
+				m_coverages[x] = static_cast<unsigned char>(coverage*255.0f + 0.5f);
+			}
+			std::fill_n(row, m_stride, 0.0f);
+		}
+		
+		void addSides(SideList sides, float scale)
+		{
+			for (const std::array<int, 4>& side: sides)
+			{
+				addClippedLine(side[0]*scale - m_xMin, side[1]*scale - m_yMin, side[2]*scale - m_xMin,
+					side[3]*scale - m_yMin);
+			}
+		}
+		
+	public:
+		explicit CoverageRasterizer(const Canvas& canvas = k_window):
+			m_xMin(canvas.xMin), m_yMin(canvas.yMin), m_width(canvas.getWidth()), m_height(canvas.getHeight()),
+			m_stride(m_width + 2), m_cells(static_cast<std::size_t>(m_height)*m_stride, 0.0f), m_coverages(m_width) {}
+		
+		// Adds a polygon whose vertices are pixel corners.
+		void addPolygon(SideList sides)
+		{
+			addSides(sides, 1.0f);
+		}
+		
+		// Adds a polygon whose coordinates are in units of 1/`k_subpixelScale` pixel.
+		void addSubpixelPolygon(SideList sides)
+		{
+			addSides(sides, 1.0f / k_subpixelScale);
+		}
+		
+		/*
+		 * Blends `color` over `framebuffer`, whose pixel (0, 0) is the canvas's corner (`xMin`, `yMin`), by the coverage
+		 * of the polygons added since the last call, and clears them. Polygons resolved together are filled as one shape.
+		 */
+		void resolve(Framebuffer& framebuffer, unsigned int color)
+		{
+			framebuffer.setColor(color);
+			for (int y = 0; y < m_height; ++y)
+			{
+				accumulateRow(y);
+				framebuffer.blendRow(0, y, m_coverages.data(), m_width);
+			}
+		}
+};
+
+using vertex_t = std::array<double, 2>;
+
+double cross(const vertex_t& a, const vertex_t& b, const vertex_t& c)
+{
+	return (b[0] - a[0])*(c[1] - a[1]) - (b[1] - a[1])*(c[0] - a[0]);
+}
+
+double signedArea(const std::vector<vertex_t>& polygon)
+{
+	double area = 0.0;
+	for (std::size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+		area += polygon[j][0]*polygon[i][1] - polygon[i][0]*polygon[j][1];
+	return area / 2;
+}
+
+// Even-odd test; points on the boundary may go either way.
+bool containsPoint(const std::vector<vertex_t>& polygon, const vertex_t& p)
+{
+	bool inside = false;
+	for (std::size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
 	{
-		activeSides.remove_if([=](Side& s){return y >= s.getMaxY();});
-		activeSides.sort();
-		activeSides.merge(rows[i]);
-		auto orig(activeSides.begin()), dest(activeSides.begin());
-		bool filling = true;
-		while (++dest != activeSides.end())
-		{
-			if (filling)
-				lineBresenham(orig->getIntercept(), y, dest->getIntercept(), y);
-			orig->incrY();
-			filling = !filling;
-			++orig;
-		}
-		if (activeSides.size())
-			activeSides.back().incrY();
+		const vertex_t &a = polygon[j], &b = polygon[i];
+		if ((a[1] > p[1]) != (b[1] > p[1]) && p[0] < a[0] + (p[1] - a[1]) * (b[0] - a[0]) / (b[1] - a[1]))
+			inside = !inside;
 	}
+	return inside;
 }
 
+/*
+ * Clips polygons to a clip region before they are scan converted, and hands the result back as the sides `ScanFiller`
+ * takes, so that no off-screen row or column is ever visited. The clip region is either an axis-aligned rectangle, such as
+ * the viewport, or an arbitrary simple polygon.
+ *
+ * Rectangles and other convex regions are handled by Sutherland–Hodgman, with a fast path for rectangles that compares
+ * one coordinate per side instead of taking cross products. A concave subject can come out of Sutherland–Hodgman with
+ * degenerate edges running along the clip boundary in both directions; these cancel out under the even-odd rule that
+ * `ScanFiller` uses. Concave clip regions are handled by Weiler–Atherton, which can split the subject into several contours.
+ * Weiler–Atherton needs the two boundaries to be in general position, so that every intersection is a proper crossing. A
+ * concave clip region is therefore shifted by a distance far below the precision of the rounded output, which keeps integer
+ * vertices from lying exactly on its edges or corners.
+ *
+ * All working storage is kept in members and cleared rather than freed between calls.
+ */
+class PolygonClipper
+{
+	private:
+		// A vertex of one of the two lists that Weiler–Atherton walks. Intersections appear in both lists, linked by
+		// `neighbor`.
+		struct Node
+		{
+			vertex_t point;
+			bool intersection;
+			bool entering;
+			bool visited;
+			std::size_t neighbor;
+		};
+		
+		struct Intersection
+		{
+			std::size_t subjectEdge;
+			std::size_t clipEdge;
+			double t;
+			double u;
+			vertex_t point;
+			bool entering;
+		};
+		
+		bool m_rectangle;
+		bool m_convex;
+		// Counter-clockwise.
+		std::vector<vertex_t> m_clip;
+		std::vector<vertex_t> m_input;
+		std::vector<vertex_t> m_output;
+		std::vector<vertex_t> m_vertices;
+		std::vector<std::size_t> m_contourStarts;
+		std::vector<Intersection> m_intersections;
+		std::vector<std::size_t> m_order;
+		std::vector<std::size_t> m_subjectPositions;
+		std::vector<std::size_t> m_clipPositions;
+		std::vector<Node> m_subjectNodes;
+		std::vector<Node> m_clipNodes;
+		
+		// One Sutherland–Hodgman pass, from `m_input` to `m_output`, against the side where `inside` is true.
+		template <typename InsidePredicate, typename IntersectFunction>
+		void clipToSide(const InsidePredicate& inside, const IntersectFunction& intersect)
+		{
+			m_output.clear();
+			if (m_input.empty())
+				return;
+			const vertex_t* previous = &m_input.back();
+			bool previousInside = inside(*previous);
+			for (const vertex_t& current: m_input)
+			{
+				bool currentInside = inside(current);
+				if (currentInside != previousInside)
+					m_output.push_back(intersect(*previous, current));
+				if (currentInside)
+					m_output.push_back(current);
+				previous = &current, previousInside = currentInside;
+			}
+			m_input.swap(m_output);
+		}
+		
+		void clipToRectangle()
+		{
+			double xMin = m_clip[0][0], yMin = m_clip[0][1], xMax = m_clip[2][0], yMax = m_clip[2][1];
+			auto atX = [](double x)
+			{
+				return [=](const vertex_t& a, const vertex_t& b)
+					{return vertex_t{x, a[1] + (x - a[0]) * (b[1] - a[1]) / (b[0] - a[0])};};
+			};
+			auto atY = [](double y)
+			{
+				return [=](const vertex_t& a, const vertex_t& b)
+					{return vertex_t{a[0] + (y - a[1]) * (b[0] - a[0]) / (b[1] - a[1]), y};};
+			};
+			clipToSide([=](const vertex_t& v){return v[0] >= xMin;}, atX(xMin));
+			clipToSide([=](const vertex_t& v){return v[0] <= xMax;}, atX(xMax));
+			clipToSide([=](const vertex_t& v){return v[1] >= yMin;}, atY(yMin));
+			clipToSide([=](const vertex_t& v){return v[1] <= yMax;}, atY(yMax));
+		}
+		
+		void clipToConvex()
+		{
+			for (std::size_t i = 0, j = m_clip.size() - 1; i < m_clip.size(); j = i++)
+			{
+				const vertex_t &a = m_clip[j], &b = m_clip[i];
+				clipToSide([&](const vertex_t& v){return cross(a, b, v) >= 0;},
+					[&](const vertex_t& p, const vertex_t& q)
+					{
+						double s = cross(a, b, p) / (cross(a, b, p) - cross(a, b, q));
+						return vertex_t{p[0] + s*(q[0] - p[0]), p[1] + s*(q[1] - p[1])};
+					});
+			}
+		}
+		
+		void findIntersections()
+		{
+			m_intersections.clear();
+			const std::vector<vertex_t>& subject = m_input;
+			for (std::size_t i = 0; i < subject.size(); ++i)
+			{
+				const vertex_t &p = subject[i], &pNext = subject[(i + 1) % subject.size()];
+				vertex_t r{pNext[0] - p[0], pNext[1] - p[1]};
+				for (std::size_t j = 0; j < m_clip.size(); ++j)
+				{
+					const vertex_t &q = m_clip[j], &qNext = m_clip[(j + 1) % m_clip.size()];
+					vertex_t s{qNext[0] - q[0], qNext[1] - q[1]};
+					double denominator = r[0]*s[1] - r[1]*s[0];
+					if (!denominator)
+						continue;
+					double t = ((q[0] - p[0])*s[1] - (q[1] - p[1])*s[0]) / denominator;
+					double u = ((q[0] - p[0])*r[1] - (q[1] - p[1])*r[0]) / denominator;
+					// The subject enters the (counter-clockwise) clip region when it crosses an edge from right to left.
+					if (t >= 0.0 && t < 1.0 && u >= 0.0 && u < 1.0)
+						m_intersections.push_back({i, j, t, u, vertex_t{p[0] + t*r[0], p[1] + t*r[1]}, denominator < 0});
+				}
+			}
+		}
+		
+		/*
+		 * Builds the node list for one polygon: its vertices, with the intersections on each edge inserted after the edge's
+		 * first vertex in order of their parameter along the edge. `edgeOf` and `paramOf` pick the polygon's side of an
+		 * `Intersection`, and `positions` receives the index of each intersection's node.
+		 */
+		template <typename EdgeOf, typename ParamOf>
+		void buildNodes(const std::vector<vertex_t>& polygon, std::vector<Node>& nodes, const EdgeOf& edgeOf,
+			const ParamOf& paramOf, std::vector<std::size_t>& positions)
+		{
+			m_order.resize(m_intersections.size());
+			for (std::size_t i = 0; i < m_order.size(); ++i)
+				m_order[i] = i;
+			std::sort(m_order.begin(), m_order.end(), [&](std::size_t a, std::size_t b)
+			{
+				const Intersection &first = m_intersections[a], &second = m_intersections[b];
+				return edgeOf(first) != edgeOf(second) ? edgeOf(first) < edgeOf(second) : paramOf(first) < paramOf(second);
+			});
+			nodes.clear();
+			positions.resize(m_intersections.size());
+			auto next = m_order.begin();
+			for (std::size_t i = 0; i < polygon.size(); ++i)
+			{
+				nodes.push_back({polygon[i], false, false, false, 0});
+				for (; next != m_order.end() && edgeOf(m_intersections[*next]) == i; ++next)
+				{
+					positions[*next] = nodes.size();
+					nodes.push_back({m_intersections[*next].point, true, m_intersections[*next].entering, false, 0});
+				}
+			}
+		}
+		
+		void clipWeilerAtherton()
+		{
+			if (signedArea(m_input) < 0)
+				std::reverse(m_input.begin(), m_input.end());
+			findIntersections();
+			if (m_intersections.empty())
+			{
+				if (containsPoint(m_clip, m_input[0]))
+					addContour(m_input.begin(), m_input.end());
+				else if (containsPoint(m_input, m_clip[0]))
+					addContour(m_clip.begin(), m_clip.end());
+				return;
+			}
+			buildNodes(m_input, m_subjectNodes, [](const Intersection& i){return i.subjectEdge;},
+				[](const Intersection& i){return i.t;}, m_subjectPositions);
+			buildNodes(m_clip, m_clipNodes, [](const Intersection& i){return i.clipEdge;},
+				[](const Intersection& i){return i.u;}, m_clipPositions);
+			for (std::size_t i = 0; i < m_intersections.size(); ++i)
+			{
+				m_subjectNodes[m_subjectPositions[i]].neighbor = m_clipPositions[i];
+				m_clipNodes[m_clipPositions[i]].neighbor = m_subjectPositions[i];
+			}
+			for (std::size_t start = 0; start < m_subjectNodes.size(); ++start)
+			{
+				Node& first = m_subjectNodes[start];
+				if (!first.intersection || !first.entering || first.visited)
+					continue;
+				std::size_t contourStart = m_vertices.size();
+				first.visited = m_clipNodes[first.neighbor].visited = true;
+				m_vertices.push_back(first.point);
+				// Follow the subject until it leaves the clip region, then the clip boundary until the subject re-enters it,
+				// and so on, until the walk is back where it started.
+				std::size_t node = start;
+				bool onSubject = true;
+				for (;;)
+				{
+					std::vector<Node>& nodes = onSubject ? m_subjectNodes : m_clipNodes;
+					node = (node + 1) % nodes.size();
+					Node& current = nodes[node];
+					if (current.intersection)
+					{
+						current.visited = (onSubject ? m_clipNodes : m_subjectNodes)[current.neighbor].visited = true;
+						onSubject = !onSubject, node = current.neighbor;
+						if (onSubject && node == start)
+							break;
+					}
+					m_vertices.push_back(current.point);
+				}
+				m_contourStarts.push_back(contourStart);
+			}
+		}
+		
+		template <typename Iterator>
+		void addContour(Iterator first, Iterator last)
+		{
+			m_contourStarts.push_back(m_vertices.size());
+			m_vertices.insert(m_vertices.end(), first, last);
+		}
+		
+		void initClip(std::vector<vertex_t> clip)
+		{
+			static constexpr vertex_t k_perturbation{1.31e-7, 2.17e-7};
+			m_clip = std::move(clip);
+			if (signedArea(m_clip) < 0)
+				std::reverse(m_clip.begin(), m_clip.end());
+			m_convex = true;
+			for (std::size_t i = 0; i < m_clip.size(); ++i)
+			{
+				if (cross(m_clip[i], m_clip[(i + 1) % m_clip.size()], m_clip[(i + 2) % m_clip.size()]) < 0)
+					m_convex = false;
+			}
+			if (!m_convex)
+			{
+				for (vertex_t& v: m_clip)
+					v[0] += k_perturbation[0], v[1] += k_perturbation[1];
+			}
+		}
+		
+	public:
+		// Clips to the rectangle with corners (`xMin`, `yMin`) and (`xMax`, `yMax`).
+		PolygonClipper(double xMin, double yMin, double xMax, double yMax): m_rectangle(true)
+		{
+			initClip({{xMin, yMin}, {xMax, yMin}, {xMax, yMax}, {xMin, yMax}});
+		}
+		
+		// Clips to a simple polygon of either orientation.
+		explicit PolygonClipper(std::vector<vertex_t> clip): m_rectangle(false)
+		{
+			initClip(std::move(clip));
+		}
+		
+		/*
+		 * Clips the polygon whose consecutive vertices are the first endpoints of `sides` (the representation `ScanFiller`
+		 * uses), and replaces the contents of `clipped` with the sides of the result, rounded to integer coordinates.
+		 */
+		void clip(SideList sides, std::vector<std::array<int, 4>>& clipped)
+		{
+			m_input.clear();
+			m_vertices.clear();
+			m_contourStarts.clear();
+			for (const std::array<int, 4>& side: sides)
+				m_input.push_back({static_cast<double>(side[0]), static_cast<double>(side[1])});
+			if (m_input.size() >= 3)
+			{
+				if (m_rectangle)
+					clipToRectangle();
+				else if (m_convex)
+					clipToConvex();
+				if (m_rectangle || m_convex)
+					addContour(m_input.begin(), m_input.end());
+				else
+					clipWeilerAtherton();
+			}
+			clipped.clear();
+			for (std::size_t contour = 0; contour < m_contourStarts.size(); ++contour)
+			{
+				std::size_t first = m_contourStarts[contour];
+				std::size_t last = contour + 1 < m_contourStarts.size() ? m_contourStarts[contour + 1] : m_vertices.size();
+				for (std::size_t i = first; i < last; ++i)
+				{
+					const vertex_t &a = m_vertices[i], &b = m_vertices[i + 1 < last ? i + 1 : first];
+					clipped.push_back({static_cast<int>(std::lround(a[0])), static_cast<int>(std::lround(a[1])),
+						static_cast<int>(std::lround(b[0])), static_cast<int>(std::lround(b[1]))});
+				}
+			}
+		}
+};
+
 void init()
 {
 	glClearColor(1.0, 1.0, 1.0, 0.0);
@@ -165,15 +1193,184 @@ void fillPoly()
 		{220, 112, 250, 160},
 		{250, 160, 300, 50}
 	};
-	glColor3d(0.0, 0.0, 0.0);
-	glBegin(GL_POINTS);
-	scanFill(vertices);
-	glEnd();
-	glFlush();
+	// Clipping to the window means that the parts of the polygon off screen are never scanned.
+	static PolygonClipper viewport(k_xMin, k_yMin, k_xMax, k_yMax);
+	static std::vector<std::array<int, 4>> clipped;
+	viewport.clip(vertices, clipped);
+	static ScanFiller filler;
+	GLSink sink;
+	sink.begin();
+	sink.setColor(packColor(0.0, 0.0, 0.0));
+	filler.fill(sink, clipped);
+	sink.end();
+}
+
+struct DatasetSettings
+{
+	const char* input = nullptr;
+	const char* output = nullptr;
+	int width = k_width;
+	int height = k_height;
+	// With more than one, polygons are filled by a `BandedScanFiller` on a pool of this many threads.
+	unsigned int threadCount = 1;
+	// Whether the whole dataset is drawn as one scene by a `SceneRenderer`, with `rule`.
+	bool scene = false;
+	FillRule rule = FillRule::evenOdd;
+	// Whether each polygon is blended in by its coverage, through a `CoverageRasterizer`.
+	bool antialiased = false;
+};
+
+// Calls `draw` with each polygon of `dataset`, in the order they are stored. Returns false if one is damaged.
+template <typename Draw>
+bool forEachPolygon(PolygonDatasetReader& dataset, const char* path, Draw draw)
+{
+	PolygonDatasetReader::Polygon polygon;
+	for (std::uint64_t i = 0; i < dataset.getPolygonCount(); ++i)
+	{
+		if (!dataset.read(i, polygon))
+		{
+			std::fprintf(stderr, "polygon %llu of %s is damaged\n", static_cast<unsigned long long>(i), path);
+			return false;
+		}
+		draw(polygon);
+	}
+	return true;
+}
+
+/*
+ * Fills every polygon of a dataset written by `polyconv` into an image, in the order they are stored, and writes it as
+ * a PPM. Polygons are read one at a time from the mapped file and scanned straight from it, so the memory used depends
+ * on the image and the largest polygon, not on the size of the dataset. Filling in bands on several threads gives
+ * exactly the same image.
+ *
+ * As a scene, each polygon's priority is its index, so the image is again the same as filling them in order with the
+ * even-odd rule, but every polygon is held in memory until the scene is rendered. Antialiased, each polygon is filled
+ * with the non-zero rule and blended in over the whole image before the next is read.
+ */
+bool fillDataset(const DatasetSettings& settings)
+{
+	PolygonDatasetReader dataset;
+	if (!dataset.open(settings.input))
+	{
+		std::fprintf(stderr, "%s is not a polygon dataset\n", settings.input);
+		return false;
+	}
+	if (dataset.getSubpixelBits() != k_subpixelBits)
+	{
+		std::fprintf(stderr, "%s has %d sub-pixel bits rather than %d\n", settings.input, dataset.getSubpixelBits(),
+			k_subpixelBits);
+		return false;
+	}
+	Framebuffer image(settings.width, settings.height);
+	Canvas canvas{0, 0, settings.width, settings.height};
+	bool read;
+	if (settings.scene)
+	{
+		if (dataset.getPolygonCount() > static_cast<std::uint64_t>(std::numeric_limits<int>::max()))
+		{
+			std::fprintf(stderr, "%s has too many polygons for one scene\n", settings.input);
+			return false;
+		}
+		SceneRenderer renderer(canvas);
+		int priority = 0;
+		read = forEachPolygon(dataset, settings.input, [&](const PolygonDatasetReader::Polygon& polygon)
+		{
+			renderer.addSubpixelPolygon(SideList(polygon.sides, polygon.sideCount), polygon.color, priority++,
+				settings.rule);
+		});
+		if (read)
+			renderer.render(image);
+	}
+	else if (settings.antialiased)
+	{
+		CoverageRasterizer rasterizer(canvas);
+		read = forEachPolygon(dataset, settings.input, [&](const PolygonDatasetReader::Polygon& polygon)
+		{
+			rasterizer.addSubpixelPolygon(SideList(polygon.sides, polygon.sideCount));
+			rasterizer.resolve(image, polygon.color);
+		});
+	}
+	else if (settings.threadCount > 1)
+	{
+		ThreadPool pool(settings.threadCount);
+		BandedScanFiller filler(pool, canvas);
+		read = forEachPolygon(dataset, settings.input, [&](const PolygonDatasetReader::Polygon& polygon)
+		{
+			image.setColor(polygon.color);
+			filler.fillSubpixel(image, SideList(polygon.sides, polygon.sideCount));
+		});
+	}
+	else
+	{
+		ScanFiller filler(canvas);
+		read = forEachPolygon(dataset, settings.input, [&](const PolygonDatasetReader::Polygon& polygon)
+		{
+			image.setColor(polygon.color);
+			filler.fillSubpixel(image, SideList(polygon.sides, polygon.sideCount));
+		});
+	}
+	return read && image.writePPM(settings.output);
 }
 
+bool parseDatasetArguments(int argc, char** argv, DatasetSettings& settings)
+{
+	if (argc < 4)
+		return false;
+	settings.input = argv[2], settings.output = argv[3];
+	int i = 4;
+	if (i < argc && std::strncmp(argv[i], "--", 2))
+	{
+		if (i + 1 >= argc)
+			return false;
+		settings.width = std::atoi(argv[i]), settings.height = std::atoi(argv[i + 1]);
+		i += 2;
+	}
+	for (; i < argc; ++i)
+	{
+		if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+		{
+			int threadCount = std::atoi(argv[++i]);
+			if (threadCount <= 0)
+				return false;
+			settings.threadCount = static_cast<unsigned int>(threadCount);
+		}
+		else if (!std::strcmp(argv[i], "--aa"))
+			settings.antialiased = true;
+		else if (!std::strcmp(argv[i], "--scene") && i + 1 < argc)
+		{
+			settings.scene = true;
+			++i;
+			if (!std::strcmp(argv[i], "even-odd"))
+				settings.rule = FillRule::evenOdd;
+			else if (!std::strcmp(argv[i], "non-zero"))
+				settings.rule = FillRule::nonZero;
+			else
+				return false;
+		}
+		else
+			return false;
+	}
+	// Only one way of drawing may be chosen; scenes and antialiased polygons are drawn on the calling thread.
+	if (settings.scene + settings.antialiased + (settings.threadCount > 1) > 1)
+		return false;
+	return settings.width > 0 && settings.height > 0;
+}
+
+// Usage: scanfill [--dataset <input.pld> <output.ppm> [<width> <height>]
+//                  [--threads <count> | --scene <even-odd|non-zero> | --aa]]
 int main(int argc, char** argv)
 {
+	if (argc >= 2 && !std::strcmp(argv[1], "--dataset"))
+	{
+		DatasetSettings settings;
+		if (!parseDatasetArguments(argc, argv, settings))
+		{
+			std::fprintf(stderr, "usage: %s --dataset <input.pld> <output.ppm> [<width> <height>] "
+				"[--threads <count> | --scene <even-odd|non-zero> | --aa]\n", argv[0]);
+			return 2;
+		}
+		return fillDataset(settings) ? 0 : 1;
+	}
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
 	glutInitWindowPosition(100, 100);
@@ -0,0 +1,246 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * A fixed set of worker threads for data-parallel loops. `parallelFor` hands out the indices of a loop one at a time from
+ * an atomic counter, so that threads which finish early keep taking work, and the calling thread takes part as well. The
+ * threads are started once and sleep between loops, so a loop costs a wake-up rather than a thread launch.
+ *
+ * `parallelForStealing` runs a loop by work stealing instead, for loops whose iterations differ widely in cost. Every
+ * thread starts with an equal, contiguous share of the indices and takes them from the front, one at a time. A thread
+ * that runs out takes the back half of the indices left to another thread, so neighbouring indices mostly stay on the
+ * same thread, and threads only touch each other's state when one of them is idle. These loops also record how each
+ * thread spent its time, in `WorkerStats`.
+ *
+ * One loop runs at a time; neither function may be called from inside the body of another loop.
+ */
+class ThreadPool
+{
+	public:
+		struct WorkerStats
+		{
+			std::size_t indices = 0;
+			// The number of times the thread took indices from another.
+			std::size_t steals = 0;
+			// The time spent in the body of the loop.
+			double busySeconds = 0.0;
+		};
+		
+	private:
+		// The indices left to one thread in a loop run by `parallelForStealing`, as a range packed into one word so
+		// that it can be shrunk from either end by a single compare-and-swap.
+		struct Worker
+		{
+			std::atomic<std::uint64_t> range{0};
+			WorkerStats stats;
+			// Keeps neighbouring ranges off the same cache line, since `new` only aligns to one from C++17.
+			char padding[64];
+		};
+		
+		std::vector<std::thread> m_threads;
+		std::unique_ptr<Worker[]> m_workers;
+		double m_loopSeconds = 0.0;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		// The body of the current loop, erased to a pointer and a function that calls it, so that starting a loop
+		// allocates nothing.
+		const void* m_body = nullptr;
+		void (*m_invoke)(const void*, std::size_t) = nullptr;
+		bool m_stealing = false;
+		std::size_t m_count = 0;
+		std::atomic<std::size_t> m_next{0};
+		std::size_t m_generation = 0;
+		std::size_t m_busy = 0;
+		bool m_stopping = false;
+		
+		static std::uint64_t packRange(std::uint32_t begin, std::uint32_t end)
+		{
+			return std::uint64_t{end} << 32 | begin;
+		}
+		
+		static std::uint32_t getBegin(std::uint64_t range) {return static_cast<std::uint32_t>(range);}
+		static std::uint32_t getEnd(std::uint64_t range) {return static_cast<std::uint32_t>(range >> 32);}
+		
+		void runIndices()
+		{
+			for (std::size_t i; (i = m_next.fetch_add(1)) < m_count;)
+				m_invoke(m_body, i);
+		}
+		
+		// Takes the first index left to `worker`, returning false if there is none.
+		bool takeFront(Worker& worker, std::uint32_t& index)
+		{
+			std::uint64_t range = worker.range.load();
+			do
+			{
+				if (getBegin(range) >= getEnd(range))
+					return false;
+			}
+			while (!worker.range.compare_exchange_weak(range, packRange(getBegin(range) + 1, getEnd(range))));
+			index = getBegin(range);
+			return true;
+		}
+		
+		// Moves the back half of the indices left to `victim` to `thief`, whose own range must be empty.
+		bool steal(Worker& thief, Worker& victim)
+		{
+			std::uint64_t range = victim.range.load();
+			std::uint32_t middle;
+			do
+			{
+				if (getBegin(range) >= getEnd(range))
+					return false;
+				middle = getBegin(range) + (getEnd(range) - getBegin(range)) / 2;
+			}
+			while (!victim.range.compare_exchange_weak(range, packRange(getBegin(range), middle)));
+			thief.range.store(packRange(middle, getEnd(range)));
+			++thief.stats.steals;
+			return true;
+		}
+		
+		void runStealing(std::size_t self)
+		{
+			using clock = std::chrono::steady_clock;
+			Worker& worker = m_workers[self];
+			std::size_t workerCount = m_threads.size() + 1;
+			for (;;)
+			{
+				for (std::uint32_t i; takeFront(worker, i);)
+				{
+					auto start = clock::now();
+					m_invoke(m_body, i);
+					worker.stats.busySeconds += std::chrono::duration<double>(clock::now() - start).count();
+					++worker.stats.indices;
+				}
+				// Victims are tried in turn from the next thread on, so that idle threads spread out over the others.
+				bool stolen = false;
+				for (std::size_t i = 1; i < workerCount && !stolen; ++i)
+					stolen = steal(worker, m_workers[(self + i) % workerCount]);
+				if (!stolen)
+					return;
+			}
+		}
+		
+		void runLoop(std::size_t self)
+		{
+			if (m_stealing)
+				runStealing(self);
+			else
+				runIndices();
+		}
+		
+		template <typename Body>
+		void startLoop(std::size_t count, const Body& body, bool stealing)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_body = &body;
+				m_invoke = [](const void* body, std::size_t i){(*static_cast<const Body*>(body))(i);};
+				m_stealing = stealing;
+				m_count = count;
+				m_next = 0;
+				m_busy = m_threads.size();
+				++m_generation;
+			}
+			m_wake.notify_all();
+			runLoop(0);
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_done.wait(lock, [&]{return !m_busy;});
+		}
+		
+		void work(std::size_t self)
+		{
+			std::size_t seen = 0;
+			std::unique_lock<std::mutex> lock(m_mutex);
+			for (;;)
+			{
+				m_wake.wait(lock, [&]{return m_stopping || m_generation != seen;});
+				if (m_stopping)
+					return;
+				seen = m_generation;
+				lock.unlock();
+				runLoop(self);
+				lock.lock();
+				if (!--m_busy)
+					m_done.notify_one();
+			}
+		}
+		
+	public:
+		// `threadCount` includes the thread that calls `parallelFor`, so a pool of one runs every loop serially. `max` is
+		// parenthesized since this header may follow a windows.h that defines it as a macro.
+		explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency()):
+			m_workers(new Worker[(std::max)(threadCount, 1u)])
+		{
+			for (unsigned int i = 1; i < (std::max)(threadCount, 1u); ++i)
+				m_threads.emplace_back(&ThreadPool::work, this, i);
+		}
+		
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stopping = true;
+			}
+			m_wake.notify_all();
+			for (std::thread& thread: m_threads)
+				thread.join();
+		}
+		
+		unsigned int getThreadCount() const {return static_cast<unsigned int>(m_threads.size()) + 1;}
+		
+		// Calls `body(i)` for every `i` from 0 to `count` - 1, in no particular order, and returns once all calls have.
+		template <typename Body>
+		void parallelFor(std::size_t count, const Body& body)
+		{
+			if (m_threads.empty() || count <= 1)
+			{
+				for (std::size_t i = 0; i < count; ++i)
+					body(i);
+				return;
+			}
+			startLoop(count, body, false);
+		}
+		
+		/*
+		 * As `parallelFor`, but with work stealing, for at most 2^32 - 1 indices. Afterwards, `getWorkerStats` and
+		 * `getLoopSeconds` tell how the loop went.
+		 */
+		template <typename Body>
+		void parallelForStealing(std::size_t count, const Body& body)
+		{
+			auto start = std::chrono::steady_clock::now();
+			std::size_t workerCount = m_threads.size() + 1;
+			for (std::size_t i = 0; i < workerCount; ++i)
+			{
+				m_workers[i].stats = WorkerStats{};
+				m_workers[i].range = packRange(static_cast<std::uint32_t>(i*count / workerCount),
+					static_cast<std::uint32_t>((i + 1)*count / workerCount));
+			}
+			startLoop(count, body, true);
+			m_loopSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		
+		// How thread `i` spent the last loop run by `parallelForStealing`; thread 0 is the one that called it.
+		const WorkerStats& getWorkerStats(unsigned int i) const {return m_workers[i].stats;}
+		
+		// The time the last loop run by `parallelForStealing` took from start to finish.
+		double getLoopSeconds() const {return m_loopSeconds;}
+};
+
+#endif